@@ -0,0 +1,64 @@
+#ifndef CHIP8_AOT_H
+#define CHIP8_AOT_H
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+#include "chip8/Chip8.h"
+
+/**
+ * Runtime support for statically recompiled ROMs.
+ *
+ * The chip8_aot tool translates the code reachable from Chip8::pc_start_address of a ROM into a
+ * C++ translation unit (see AotTranslator.h). Linking that translation unit registers the compiled
+ * blocks; Chip8 picks them up when a ROM with the same hash is loaded and runs them with
+ * Backend::Aot. Indirect jumps (BNNN), code outside the recovered blocks and blocks overwritten at
+ * runtime are interpreted.
+ */
+namespace chip8::aot {
+
+    // Upper bound for the number of instructions in a block.
+    static constexpr std::size_t max_block_length = 64;
+
+    // A recompiled basic block, executes length instructions starting at address.
+    struct Block {
+        uint16_t address;
+        uint16_t length;
+        uint16_t end;       // address after the last byte of the block
+        void (*fn)(Chip8 &);
+    };
+
+    struct CompiledRom {
+        uint64_t rom_hash;
+        std::size_t rom_size;
+        std::span<const Block> blocks;
+    };
+
+    void register_rom(const CompiledRom &rom);
+
+    /**
+     * The registered recompiled ROM with the given hash and size or nullptr.
+     */
+    [[nodiscard]] const CompiledRom *find_rom(uint64_t rom_hash, std::size_t rom_size);
+
+    // Registers a recompiled ROM during static initialization of the generated translation unit.
+    struct Registration {
+        explicit Registration(const CompiledRom &rom) { register_rom(rom); }
+    };
+
+    // Access to the machine state for generated code.
+    struct Access {
+        static std::array<uint8_t, Chip8::num_registers> &V(Chip8 &chip8) { return chip8.V; }
+        static uint16_t &I(Chip8 &chip8) { return chip8.I; }
+        static uint16_t &PC(Chip8 &chip8) { return chip8.PC; }
+        static uint8_t &delay_timer(Chip8 &chip8) { return chip8.delay_timer; }
+        static uint8_t &sound_timer(Chip8 &chip8) { return chip8.sound_timer; }
+        static bool shift_vy(const Chip8 &chip8) { return chip8.shift_implementation_vy; }
+        // execute an instruction through the interpreter, PC has to point behind it
+        static void exec(Chip8 &chip8, uint16_t opcode);
+    };
+
+} // namespace chip8::aot
+
+#endif //CHIP8_AOT_H
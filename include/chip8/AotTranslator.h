@@ -0,0 +1,27 @@
+#ifndef CHIP8_AOTTRANSLATOR_H
+#define CHIP8_AOTTRANSLATOR_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace chip8::aot {
+
+    /**
+     * Translate a ROM into a C++ translation unit.
+     *
+     * Code is recovered by following jumps, calls and skips from Chip8::pc_start_address. Every
+     * basic block becomes a function operating on the Chip8 register file; instructions without a
+     * native translation call back into the interpreter. The translation unit registers the blocks
+     * for the hash of the ROM (see Aot.h).
+     *
+     * @param rom the ROM image as loaded at pc_start_address
+     * @param rom_name name of the ROM, used in comments only
+     * @return C++ source code
+     */
+    [[nodiscard]] std::string translate_rom(std::span<const uint8_t> rom, std::string_view rom_name);
+
+} // namespace chip8::aot
+
+#endif //CHIP8_AOTTRANSLATOR_H
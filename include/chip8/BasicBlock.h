@@ -0,0 +1,43 @@
+#ifndef CHIP8_BASICBLOCK_H
+#define CHIP8_BASICBLOCK_H
+
+#include <cstdint>
+
+#include "chip8/InstructionPartAccessorFunctions.h"
+
+namespace chip8 {
+
+    /**
+     * Does the instruction end a basic block?
+     *
+     * True for every instruction after which the next instruction is not necessarily the following
+     * one in memory (jumps, calls, returns, skips, key wait) and for the instructions writing to
+     * memory (FX33, FX55), because they can modify the code that follows them.
+     *
+     * @param opcode a Chip8 opcode
+     */
+    [[nodiscard]] constexpr bool ends_basic_block(uint16_t opcode) {
+        switch (get4Bit(opcode, 12)) {
+            case 0x0:
+                return opcode == 0x00EE;
+            case 0x1:
+            case 0x2:
+            case 0x3:
+            case 0x4:
+            case 0x5:
+            case 0x9:
+            case 0xB:
+            case 0xE:
+                return true;
+            case 0xF: {
+                const auto low = nn(opcode);
+                return low == 0x0A || low == 0x33 || low == 0x55;
+            }
+            default:
+                return false;
+        }
+    }
+
+}
+
+#endif //CHIP8_BASICBLOCK_H
@@ -0,0 +1,84 @@
+#ifndef CHIP8_BATCH_H
+#define CHIP8_BATCH_H
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "chip8/Chip8.h"
+
+/**
+ * Running many independent ROM/quirk/input/seed combinations on all cores.
+ *
+ * A manifest describes one job per line as space separated key=value pairs, paths are relative to
+ * the manifest. Empty lines and lines starting with # are ignored.
+ *
+ *   rom=roms/pong.ch8 frames=600 seed=42 backend=jit shift=vx stack=12 cycles=10 input=pong.keys hashes=1
+ *
+ * rom is required, the other keys are optional: name (defaults to the line number), frames (600),
+ * cycles (cycles per frame, 8), backend (interpreter, threaded, jit, aot), shift (vy or vx),
+ * stack (stack depth, 16), seed (0), idle (idle skipping, 1), hashes (record a display hash after
+ * every frame, 0) and input. An input script has one event per line: "frame key down" or
+ * "frame key up", key is the hexadecimal Chip8 key, the event applies before the frame runs.
+ */
+namespace chip8::batch {
+
+    struct InputEvent {
+        std::size_t frame = 0;
+        uint8_t key = 0;
+        bool pressed = false;
+    };
+
+    struct Job {
+        std::string name;
+        std::shared_ptr<const std::vector<uint8_t>> rom;
+        std::size_t frames = 600;
+        int cycles_per_frame = 8;
+        Backend backend = Backend::Interpreter;
+        bool shift_vy = true;
+        std::size_t stack_depth = Chip8::default_stack_depth;
+        uint64_t seed = 0;
+        bool idle_skipping = true;
+        bool record_frame_hashes = false;
+        // sorted by frame
+        std::vector<InputEvent> input;
+    };
+
+    struct Result {
+        std::size_t job = 0;            // index of the job in the batch
+        std::size_t frames = 0;         // frames run, less than the budget if the program stopped
+        std::size_t instructions = 0;
+        uint64_t state_hash = 0;        // Chip8::state_hash() at the end
+        FaultInfo fault;
+        std::vector<uint64_t> frame_hashes;
+    };
+
+    /**
+     * Parse a manifest and load the ROMs and input scripts it refers to.
+     *
+     * @return the jobs, std::nullopt if a line is invalid or a file cannot be read (the error is logged)
+     */
+    [[nodiscard]] std::optional<std::vector<Job>> parse_manifest(std::istream &manifest, const std::filesystem::path &base);
+    [[nodiscard]] std::optional<std::vector<InputEvent>> parse_input(std::istream &script);
+
+    // Run a single job on the calling thread.
+    [[nodiscard]] Result run_job(const Job &job, std::size_t index);
+
+    /**
+     * Run all jobs on threads worker threads. on_result is called once per job as soon as it
+     * finished, in completion order, never concurrently.
+     */
+    void run(std::span<const Job> jobs, unsigned threads, const std::function<void(const Result &)> &on_result);
+
+    // One line of JSON describing the result.
+    [[nodiscard]] std::string to_json(const Job &job, const Result &result);
+
+} // namespace chip8::batch
+
+#endif// CHIP8_BATCH_H
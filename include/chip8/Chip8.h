@@ -3,18 +3,94 @@
 #define CHIP8_CHIP8_H
 
 #include <array>
-#include <stack>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <algorithm>
 
+#include "chip8/Jit.h"
+#include "chip8/PixelExpansion.h"
+#include "utilities/Random.h"
+#include "utilities/RingBuffer.h"
+
 namespace chip8 {
 
+namespace aot {
+    struct Block;
+    struct Access;
+}
+
 enum class State{ Running, Paused, Reset, Empty };
 
+/**
+ * Execution engine used by Chip8::tick.
+ *
+ * Interpreter: dispatches every instruction through exec_op_cycle.
+ * Threaded: runs a whole frame in one function with labels-as-values dispatch and the register
+ * file held in locals (GCC/Clang only, falls back to the interpreter elsewhere).
+ * Jit: runs basic blocks translated to x86-64 machine code (see Jit), instructions that cannot be
+ * compiled and blocks not fitting into the rest of the frame are interpreted.
+ * Aot: runs the blocks of a statically recompiled ROM (see Aot.h) if one is linked for the
+ * loaded ROM, everything else is interpreted.
+ * Threaded, Jit and Aot do not record the instruction history shown by get_call_stack().
+ */
+enum class Backend{ Interpreter, Threaded, Jit, Aot };
+
+/**
+ * Machine errors. A fault stops the program: the state changes to State::Empty and get_fault()
+ * describes the faulting instruction.
+ */
+enum class Fault{ None, InvalidOpcode, StackOverflow, StackUnderflow };
+
+[[nodiscard]] constexpr const char *fault_name(Fault fault) {
+    switch (fault) {
+        case Fault::None: return "no fault";
+        case Fault::InvalidOpcode: return "invalid opcode";
+        case Fault::StackOverflow: return "stack overflow";
+        case Fault::StackUnderflow: return "stack underflow";
+    }
+    return "";
+}
+
+// the backend names of the command line tools and batch manifests
+[[nodiscard]] constexpr const char *backend_name(Backend backend) {
+    switch (backend) {
+        case Backend::Interpreter: return "interpreter";
+        case Backend::Threaded: return "threaded";
+        case Backend::Jit: return "jit";
+        case Backend::Aot: return "aot";
+    }
+    return "";
+}
+
+[[nodiscard]] constexpr std::optional<Backend> parse_backend(std::string_view name) {
+    for (const auto backend: {Backend::Interpreter, Backend::Threaded, Backend::Jit, Backend::Aot}) {
+        if (name == backend_name(backend)) { return backend; }
+    }
+    return std::nullopt;
+}
+
+struct FaultInfo {
+    Fault fault = Fault::None;
+    uint16_t pc = 0;        // address of the faulting instruction
+    uint16_t opcode = 0;
+};
+
+// An executed instruction and its address.
+struct HistoryEntry {
+    uint16_t pc = 0;
+    uint16_t opcode = 0;
+
+    bool operator==(const HistoryEntry &) const = default;
+};
+
 /**
 * Chip8 - the class implements a chip8 emulator.
 *
+* An instance must only be used by one thread at a time. Instances share no mutable state, so
+* different instances can run on different threads concurrently (see Batch.h).
 */
 class Chip8 {
   public:
@@ -25,7 +101,56 @@ class Chip8 {
     static constexpr auto num_registers = 16;
     static constexpr auto pc_start_address = 512;
     static constexpr auto num_opcodes = 34;
-    static constexpr auto call_stack_size = 40;
+    static constexpr auto history_size = 64;
+    static constexpr auto default_stack_depth = 16;
+    static constexpr auto max_stack_depth = 64;
+    // all memory accesses wrap around at the end of memory
+    static constexpr uint16_t address_mask = mem_size - 1;
+
+    using History = RingBuffer<HistoryEntry, history_size>;
+    using DisplayRows = std::array<uint64_t, screen_height>;
+    // one bit per display row, row 0 is the least significant bit; 64 bits leave room for 64 row displays
+    using DirtyRows = uint64_t;
+    static constexpr std::size_t max_display_consumers = 8;
+    // consumer id returned when all max_display_consumers are taken, every row is always dirty for it
+    static constexpr std::size_t untracked_consumer = max_display_consumers;
+    static constexpr DirtyRows all_rows_dirty = (DirtyRows{1} << screen_height) - 1;
+
+    /**
+     * Complete machine state as a fixed size block of plain data, see save_state().
+     *
+     * The layout has no padding, so equal states are equal byte by byte and the block can be
+     * copied, compared, hashed or written to a file as it is. The version changes whenever the
+     * layout does. The hash and size identify the ROM the state was saved with.
+     */
+    struct SaveState {
+        static constexpr uint32_t magic_number = 0x53533843; // "C8SS"
+        static constexpr uint32_t current_version = 2;
+
+        uint32_t magic = magic_number;
+        uint32_t version = current_version;
+        uint64_t seed = 0;
+        Pcg32::State random_state;
+        uint64_t tick_count = 0;
+        uint64_t rom_hash = 0;
+        DisplayRows display_rows{};
+        std::array<uint16_t, max_stack_depth> stack{};
+        std::array<uint8_t, mem_size> memory{};
+        std::array<uint8_t, num_registers> V{};
+        FaultInfo fault;
+        State state = State::Empty;
+        int32_t cycles_per_frame = 0;
+        uint16_t pc = 0;
+        uint16_t i = 0;
+        uint16_t keys = 0;                  // bit k is key k
+        uint16_t rom_size = 0;
+        uint8_t stack_pointer = 0;
+        uint8_t stack_depth = 0;
+        uint8_t delay_timer = 0;
+        uint8_t sound_timer = 0;
+        uint8_t shift_vy = 0;
+        std::array<uint8_t, 3> reserved{};
+    };
 
     Chip8();
 
@@ -35,6 +160,7 @@ class Chip8 {
     void load_rom(const RangeT &rom) {
         std::ranges::copy(rom, memory.begin() + pc_start_address);
         program_size = rom.size();
+        rom_loaded();
         reset();
     }
 
@@ -46,11 +172,22 @@ class Chip8 {
      */
     void exec_op_cycle();
     /**
-     *
+     * Decrement the delay and sound timer, has to be called at 60 Hz.
      */
     void signal();
 
+    /**
+     * One 60 Hz frame of a running program: signal() and cycles_per_frame instructions.
+     */
     void tick();
+    /**
+     * Same as tick() with a different number of instructions, see EmulationClock.
+     */
+    void tick(int instructions);
+    /**
+     * Execute instructions of a running program with the selected backend, without touching the timers.
+     */
+    void run_instructions(int count);
 
     /**
      * Get the Chip8 display buffer as a continuous array of size screen_size,
@@ -61,11 +198,40 @@ class Chip8 {
      */
     [[nodiscard]] std::array<uint8_t, screen_size> get_screen() const;
     /**
-     * Reference to the display buffer. Every bit corresponds to a pixel, grouped by 8 in uint8.
+     * Same as get_screen(), writes into a buffer of the caller.
+     */
+    void get_screen(std::span<uint8_t, screen_size> screen) const;
+    /**
+     * Write the display as RGBA8 image, top left pixel first.
+     */
+    void get_screen_rgba(std::span<uint8_t, 4 * screen_size> image, const pixels::Palette &palette = {}) const;
+    /**
+     * Copy of the display buffer. Every bit corresponds to a pixel, grouped by 8 in uint8,
+     * the most significant bit is the leftmost pixel.
      *
      * @return display buffer
      */
-    [[nodiscard]] const std::array<uint8_t, screen_height * 8> &get_display_buffer() const; // NOLINT
+    [[nodiscard]] std::array<uint8_t, screen_height * 8> get_display_buffer() const; // NOLINT
+    /**
+     * The display as one uint64 per row, the most significant bit is the leftmost pixel.
+     *
+     * @return display rows, top to bottom
+     */
+    [[nodiscard]] const DisplayRows &get_display_rows() const { return display_rows; }
+    /**
+     * Register a consumer of the display (texture upload, recorder, ...) for dirty row tracking.
+     * All rows are dirty for a new consumer.
+     *
+     * @return consumer id for take_dirty_rows; untracked_consumer after max_display_consumers
+     *         consumers, which has to redraw all rows every time
+     */
+    [[nodiscard]] std::size_t add_display_consumer();
+    /**
+     * Rows changed since the last call for this consumer. Every consumer has its own mask,
+     * taking the rows of one consumer does not change the rows of the others. All rows for
+     * untracked_consumer or an id that was never returned.
+     */
+    [[nodiscard]] DirtyRows take_dirty_rows(std::size_t consumer);
     /**
      * Current state of the emulator.
      *
@@ -88,11 +254,51 @@ class Chip8 {
     [[nodiscard]] uint16_t get_delay_timer() const { return delay_timer; }
     [[nodiscard]] uint16_t get_sound_timer() const { return sound_timer; }
     [[nodiscard]] std::size_t get_tick_count() const { return tick_count; }
+    // instructions of the tick count executed by compiled blocks of the Jit backend
+    [[nodiscard]] std::size_t get_jit_instructions() const { return jit_instructions; }
     [[nodiscard]] const std::array<uint8_t, mem_size> &get_memory() const { return memory; }
     [[nodiscard]] const std::array<uint8_t, num_registers> &get_registers() const { return V; }
-    [[nodiscard]] const std::deque<uint16_t> &get_call_stack() const { return call_stack; }
+    /**
+     * The last history_size executed instructions, newest first.
+     */
+    [[nodiscard]] const History &get_call_stack() const { return call_stack; }
+    [[nodiscard]] std::size_t get_stack_pointer() const { return stack_pointer; }
+    /**
+     * The fault that stopped the program, Fault::None while no fault occurred since the last reset.
+     */
+    [[nodiscard]] const FaultInfo &get_fault() const { return fault; }
+    /**
+     * FNV-1a hash of the machine state: registers, timers, stack, memory, display and random
+     * generator. Bookkeeping like the tick count, the history or the backend is not included, so
+     * equal hashes mean the program continues the same way on any backend.
+     */
+    [[nodiscard]] uint64_t state_hash() const;
+
+    /**
+     * Capture the machine state: memory, registers, stack, timers, display, keys, random
+     * generator, the quirks (shift implementation, stack depth) and cycles per frame. The backend
+     * and the other options of the host are not part of the state, neither is the history.
+     */
+    [[nodiscard]] SaveState save_state() const;
+    void save_state(SaveState &saved) const;
+    /**
+     * Continue from a saved state. Only the memory that differs from the current memory is
+     * copied, so the predecoded and compiled code of unchanged memory is kept and restoring a
+     * recent state costs little more than copying the registers. The history is cleared.
+     *
+     * @return false if the state was saved by an incompatible version or with another ROM, the
+     *         emulator is unchanged then
+     */
+    bool load_state(const SaveState &saved);
+    /**
+     * Same as load_state(), continues with history as instruction history instead of clearing it.
+     */
+    bool load_state(const SaveState &saved, const History &history);
 
     std::array<bool, 16> keys{};
+    // keys as bit mask, bit k is key k
+    [[nodiscard]] uint16_t get_key_mask() const;
+    void set_key_mask(uint16_t mask);
     int cycles_per_frame = 8;
     bool draw_flag = false;
 
@@ -108,33 +314,184 @@ class Chip8 {
      * @param shift_vy If true Vy is shifted, otherwise Vx.
      */
     void set_shift_implementation(bool shift_vy);
+    [[nodiscard]] bool get_shift_implementation() const { return shift_implementation_vy; }
+
+    /**
+     * Number of nested subroutine calls (2NNN) before the program is stopped with a stack overflow.
+     * The original COSMAC VIP interpreter allowed 12 levels, most later implementations 16.
+     *
+     * @param depth clamped to [1, max_stack_depth]
+     */
+    void set_stack_depth(std::size_t depth) { stack_depth = std::clamp<std::size_t>(depth, 1, max_stack_depth); }
+    [[nodiscard]] std::size_t get_stack_depth() const { return stack_depth; }
+
+    /**
+     * Seed the random number generator used by CXNN. A program started with the same seed and the
+     * same input always runs the same way, reset() restarts the random sequence of the seed.
+     * Every Chip8 is seeded from std::random_device on construction.
+     */
+    void set_seed(uint64_t t_seed);
+    [[nodiscard]] uint64_t get_seed() const { return seed; }
+    /**
+     * Complete state of the random number generator, e.g. to save and restore a running program.
+     */
+    [[nodiscard]] Pcg32::State get_random_state() const { return random_generator.get_state(); }
+    void set_random_state(const Pcg32::State &random_state) { random_generator.set_state(random_state); }
+
+    /**
+     * Choose the execution engine used by tick(). exec_op_cycle() always uses the interpreter.
+     */
+    // the jit code buffer is allocated when the Jit backend is selected the first time
+    void set_backend(Backend t_backend);
+    [[nodiscard]] Backend get_backend() const { return backend; }
+
+    /**
+     * Let the interpreter backend execute common instruction sequences of the loaded ROM
+     * (skip + jump, delay timer polling, counted loops, sprite drawing) through a single fused
+     * handler. Fusion does not change the state the emulator ends up in.
+     */
+    void set_superinstructions(bool enabled) { superinstructions = enabled; }
+
+    /**
+     * Skip the rest of a frame's instructions when the program spins in an idle loop that cannot
+     * exit before the next frame: FX0A waiting for a key, a jump to itself or a delay timer poll
+     * (FX07, 3XNN/4XNN, 1NNN). The skipped instructions are counted in the tick count and, by the
+     * interpreter backend, recorded in the history; the state the emulator ends up in is the same.
+     */
+    void set_idle_skipping(bool enabled) { idle_skipping = enabled; }
+    /**
+     * Does the program wait in an idle loop for a timer or a key? The host may sleep until the next frame.
+     */
+    [[nodiscard]] bool is_idle() const { return state == State::Running && idle_loop_length(PC) != 0; }
+
+    /**
+     * Log the fault that stops a program, on by default. Turned off while running frames that are
+     * thrown away again, their faults never happen.
+     */
+    void set_fault_logging(bool enabled) { fault_logging = enabled; }
+    [[nodiscard]] bool get_fault_logging() const { return fault_logging; }
+
+    /**
+     * Is a statically recompiled version of the loaded ROM linked into the program?
+     */
+    [[nodiscard]] bool has_recompiled_rom() const { return recompiled_rom; }
+    /**
+     * FNV-1a hash and size of the loaded ROM, as it was loaded, to recognize the ROM later on.
+     */
+    [[nodiscard]] uint64_t get_rom_hash() const { return rom_hash; }
+    [[nodiscard]] std::size_t get_rom_size() const { return program_size; }
 
   private:
+    friend class Jit;
+    friend struct aot::Access;
     using MFP = void (Chip8::*)(uint16_t);
+    using DispatchTable = std::array<MFP, 0x10000>;
+    // index into operations for every opcode, num_opcodes for invalid opcodes
+    using OpIndexTable = std::array<uint8_t, 0x10000>;
+
+    // Executes a sequence of instructions starting at the given address and returns how many
+    // instructions were executed.
+    using FusedOp = int (Chip8::*)(uint16_t);
+    static constexpr auto max_fused_length = 3;
+
+    // An instruction that has already been fetched and decoded, optionally the start of a
+    // superinstruction of at most fused_length instructions.
+    // An entry with op == nullptr has not been decoded yet.
+    struct DecodedOp {
+        MFP op = nullptr;
+        uint16_t opcode = 0;
+        FusedOp fused = nullptr;
+        int fused_length = 0;
+        // the instruction may start an idle loop, see idle_loop_length
+        bool idle = false;
+    };
 
     State state = State::Empty;
     std::size_t program_size = 0;
+    uint64_t rom_hash = 0;
 
     uint16_t PC = pc_start_address;
     uint16_t I = 0;
 
     std::array<uint8_t, num_registers> V{}; // 16 general purpose registers (VF register is used as flag)
     std::array<uint8_t, mem_size> memory{};
-    std::stack<uint16_t> stack{};
+    std::array<uint16_t, max_stack_depth> stack{};
+    std::size_t stack_pointer = 0;
+    std::size_t stack_depth = default_stack_depth;
     uint8_t delay_timer{};    // DT
     uint8_t sound_timer{};    // ST
 
-    std::array<uint8_t, 8 * screen_height> display_buffer{}; // NOLINT no overflow
+    uint64_t seed = 0;
+    Pcg32 random_generator;
+
+    DisplayRows display_rows{};
+    // rows changed since the masks of the consumers were last updated
+    DirtyRows dirty_rows = all_rows_dirty;
+    std::array<DirtyRows, max_display_consumers> consumer_dirty_rows{};
+    std::size_t display_consumers = 0;
 
     bool shift_implementation_vy = true;
-    std::deque<uint16_t> call_stack;
+    Backend backend = Backend::Interpreter;
+    bool superinstructions = true;
+    bool idle_skipping = true;
+    bool fault_logging = true;
+    History call_stack;
     std::size_t tick_count = 0;
+    std::size_t jit_instructions = 0;
+    FaultInfo fault;
+
+    // predecoded instruction for every (even and odd) memory address
+    std::array<DecodedOp, mem_size> decoded{};
+
+    // created by set_backend(Backend::Jit), most instances never use it
+    std::unique_ptr<Jit> jit;
+
+    // recompiled block for every start address, blocks overwritten at runtime are removed
+    std::array<const aot::Block *, mem_size> aot_blocks{};
+    bool recompiled_rom = false;
 
     void reset();
     void error();
+    // operations report machine errors by raising a fault, the backend stops after the instruction
+    void raise_fault(Fault kind, uint16_t opcode) { fault = {kind, 0, opcode}; }
+    // stop the program after the instruction at address raised a fault
+    void stop_on_fault(uint16_t address);
+    [[nodiscard]] bool faulted() const { return fault.fault != Fault::None; }
+    void rom_loaded();
+    void distribute_dirty_rows();
 
     [[nodiscard]] static MFP fetch_op(uint16_t opcode);
+    [[nodiscard]] DecodedOp decode(uint16_t address) const;
+    /**
+     * Drop the predecoded instructions overlapping the memory range [address, address + length).
+     * Has to be called whenever memory is written.
+     */
+    void invalidate_decoded(std::size_t address, std::size_t length);
+    [[nodiscard]] static consteval OpIndexTable make_op_index_table();
+    static const OpIndexTable op_index_table;
+    [[nodiscard]] static consteval DispatchTable make_dispatch_table();
     void incPC();
+    [[nodiscard]] uint16_t read_opcode(uint16_t address) const;
+    // bookkeeping after the instruction at address was executed
+    void retire(uint16_t address, uint16_t opcode);
+    // Execute cycles instructions with the interpreter backend
+    void run_interpreter(int cycles);
+    // Number of instructions of the idle loop starting at address, 0 if there is none or it
+    // exits during this frame
+    [[nodiscard]] int idle_loop_length(uint16_t address) const;
+    // Account for instructions instructions spent spinning in the idle loop at PC
+    void skip_idle_loop(int length, int instructions);
+    // Recognize superinstructions in the loaded ROM
+    void fuse_superinstructions();
+    // Execute up to cycles instructions with the threaded backend
+    void run_threaded(int cycles);
+    // Execute up to cycles instructions with the jit backend
+    void run_jit(int cycles);
+    // Called from compiled blocks for instructions that are not translated
+    static void jit_fallback(Chip8 *chip8, uint16_t opcode);
+    // Execute up to cycles instructions with the recompiled blocks of the ROM
+    void run_aot(int cycles);
+    void invalidate_aot(std::size_t address, std::size_t length);
     // Operations
     void op_clear_screen(uint16_t opcode);
     void op_return_from_subroutine(uint16_t opcode);
@@ -170,6 +527,12 @@ class Chip8 {
     void op_vx_to_BCD(uint16_t opcode);
     void op_regdump(uint16_t opcode);
     void op_regload(uint16_t opcode);
+    void op_invalid(uint16_t opcode);
+    // Superinstructions
+    int fused_skip_goto(uint16_t address);
+    int fused_poll_delay_timer(uint16_t address);
+    int fused_draw_sprite(uint16_t address);
+    int fused_counted_loop(uint16_t address);
 
     static constexpr std::array<std::pair<uint16_t, MFP>, num_opcodes> operations{
         {
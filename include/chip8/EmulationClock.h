@@ -0,0 +1,74 @@
+#ifndef CHIP8_EMULATIONCLOCK_H
+#define CHIP8_EMULATIONCLOCK_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+#include "chip8/Chip8.h"
+
+namespace chip8 {
+
+/**
+ * Drives a Chip8 by elapsed host time instead of by rendered frames.
+ *
+ * Every advance() runs the 60 Hz frames that became due since the last call: the timers are
+ * decremented exactly once per frame and the instructions per second are spread over the frames,
+ * the fractional instructions carried over to the next frame. After a stall (debugger, suspended
+ * process, slow host) at most max_catch_up_frames are run, the rest of the backlog is dropped.
+ * The time source is injectable, so the clock can be driven deterministically.
+ */
+class EmulationClock {
+  public:
+    using TimeSource = std::function<std::chrono::nanoseconds()>;
+
+    static constexpr int64_t timer_frequency = 60;
+    // 8 instructions per frame, the default cycles_per_frame of Chip8
+    static constexpr int default_instructions_per_second = 480;
+    static constexpr int64_t max_catch_up_frames = 5;
+
+    // the monotonic host clock
+    static std::chrono::nanoseconds steady_time();
+
+    explicit EmulationClock(TimeSource t_time_source = steady_time,
+                            int t_instructions_per_second = default_instructions_per_second);
+
+    void set_instructions_per_second(int t_instructions_per_second);
+    [[nodiscard]] int get_instructions_per_second() const { return instructions_per_second; }
+
+    /**
+     * Run the frames that became due on the chip8.
+     *
+     * @return number of frames run
+     */
+    int advance(Chip8 &chip8);
+    /**
+     * Same as advance(Chip8 &), calls run_frame(instructions) for every frame that became due
+     * instead of Chip8::tick, e.g. to do something after every frame.
+     */
+    int advance(const std::function<void(int instructions)> &run_frame);
+    /**
+     * Time left until the next frame is due, zero if it is already due.
+     */
+    [[nodiscard]] std::chrono::nanoseconds until_next_frame() const;
+    /**
+     * Start counting from now, e.g. after the program was paused.
+     */
+    void restart();
+
+  private:
+    // time since origin at which frame `frame` is due, exact without accumulating rounding errors
+    [[nodiscard]] static std::chrono::nanoseconds frame_time(int64_t frame);
+
+    TimeSource time_source;
+    int instructions_per_second;
+    std::chrono::nanoseconds origin{};
+    // frames run since origin
+    int64_t frames = 0;
+    // instructions per second not yet executed, in 1/timer_frequency instructions
+    int64_t instruction_remainder = 0;
+};
+
+} // namespace chip8
+
+#endif// CHIP8_EMULATIONCLOCK_H
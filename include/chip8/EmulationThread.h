@@ -0,0 +1,163 @@
+#ifndef CHIP8_EMULATIONTHREAD_H
+#define CHIP8_EMULATIONTHREAD_H
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <stop_token>
+#include <thread>
+#include <variant>
+
+#include "chip8/Chip8.h"
+#include "chip8/EmulationClock.h"
+#include "chip8/Movie.h"
+#include "chip8/Rewind.h"
+#include "chip8/RunAhead.h"
+#include "utilities/SpscQueue.h"
+#include "utilities/TripleBuffer.h"
+
+namespace chip8 {
+
+/**
+ * Everything the GUI shows of the emulator, copied at the end of a frame.
+ */
+struct Snapshot {
+    // number of the frame, consecutive snapshots differ by one unless frames were dropped
+    std::size_t frame = 0;
+    State state = State::Empty;
+    Chip8::DisplayRows display_rows{};
+    // rows changed during this frame
+    Chip8::DirtyRows dirty_rows = Chip8::all_rows_dirty;
+    std::array<uint8_t, Chip8::mem_size> memory{};
+    std::array<uint8_t, Chip8::num_registers> registers{};
+    Chip8::History history;
+    uint16_t pc = 0;
+    uint16_t i = 0;
+    uint16_t delay_timer = 0;
+    uint16_t sound_timer = 0;
+    std::size_t stack_pointer = 0;
+    std::size_t tick_count = 0;
+    FaultInfo fault;
+    bool sound = false;
+    int instructions_per_second = 0;
+    Backend backend = Backend::Interpreter;
+    bool rewinding = false;
+    Rewind::Stats rewind;
+    bool recording = false;
+    // a movie is loaded, tick_count can be moved with command::SeekTick
+    bool movie_loaded = false;
+    std::size_t movie_end_tick = 0;
+    // display_rows are run_ahead_frames ahead of the rest of the snapshot
+    int run_ahead_frames = 0;
+    double run_ahead_nanoseconds = 0;
+};
+
+namespace command {
+    struct TogglePause {};
+    struct ResetRom {};
+    struct LoadRom { std::string path; };
+    // execute a single instruction of a paused program
+    struct ExecuteInstruction {};
+    struct SetShiftImplementation { bool shift_vy; };
+    struct SetBackend { Backend backend; };
+    struct SetInstructionsPerSecond { int instructions; };
+    // while active, every frame steps back one frame instead of running the program
+    struct SetRewinding { bool active; };
+    // restart the loaded ROM and record a Movie until StopRecording, written to path
+    struct StartRecording { std::string path; };
+    struct StopRecording {};
+    // restart the loaded ROM and play the Movie in path, live keys are ignored until it ends
+    struct PlayMovie { std::string path; };
+    struct StopMovie {};
+    // move the program to a tick of the playing movie, forwards or backwards
+    struct SeekTick { std::size_t tick; };
+    // show the display frames ahead of the emulation, see RunAhead
+    struct SetRunAhead { int frames; };
+}
+
+using Command = std::variant<command::TogglePause, command::ResetRom, command::LoadRom, command::ExecuteInstruction,
+                             command::SetShiftImplementation, command::SetBackend, command::SetInstructionsPerSecond,
+                             command::SetRewinding, command::StartRecording, command::StopRecording,
+                             command::PlayMovie, command::StopMovie, command::SeekTick, command::SetRunAhead>;
+
+/**
+ * Runs a Chip8 on its own thread, paced by an EmulationClock independent of the GUI.
+ * Every frame the program runs is captured in a Rewind history, which is cleared when the ROM is
+ * reset or loaded. A Movie recording stops on everything that would make it unreplayable:
+ * resetting or loading a ROM, changing the shift quirk, single steps and rewinding. A played
+ * Movie stops on the same commands except single steps, which step through the movie instead.
+ * With run-ahead, the display of every published frame is the one RunAhead computed with the
+ * current keys; it is off while rewinding or playing a movie, which ignore the keys.
+ *
+ * The Chip8 belongs to the thread while it runs and must not be used by anyone else. The GUI
+ * talks to it without locks: commands go through a single producer queue, keys are a bit mask of
+ * atomic flags and every finished frame is published as a Snapshot through a triple buffer.
+ * send(), set_key(), update_snapshot() and snapshot() have to be called from the same thread.
+ */
+class EmulationThread {
+  public:
+    explicit EmulationThread(Chip8 &t_chip8, EmulationClock t_clock = EmulationClock{});
+    ~EmulationThread();
+    EmulationThread(const EmulationThread &) = delete;
+    EmulationThread(EmulationThread &&) = delete;
+    EmulationThread &operator=(const EmulationThread &) = delete;
+    EmulationThread &operator=(EmulationThread &&) = delete;
+
+    /**
+     * Queue a command, it is executed before the next frame.
+     *
+     * @return false if the queue is full and the command was dropped
+     */
+    bool send(Command command);
+    void set_key(std::size_t key, bool pressed);
+
+    /**
+     * Switch to the latest published frame.
+     *
+     * @return true if a new frame was published since the last call
+     */
+    bool update_snapshot() { return snapshots.update(); }
+    /**
+     * The frame selected by the last update_snapshot(), stays valid until the next call.
+     */
+    [[nodiscard]] const Snapshot &snapshot() const { return snapshots.read_buffer(); }
+
+  private:
+    static constexpr std::size_t command_queue_size = 64;
+
+    void run(const std::stop_token &stop);
+    void run_frame(int instructions);
+    void execute(const Command &command);
+    void start_recording(const std::string &path);
+    void stop_recording();
+    void play_movie(const std::string &path);
+    // seek the playing movie, a paused program stays paused
+    void seek(std::size_t tick);
+    void publish();
+
+    Chip8 &chip8;
+    EmulationClock clock;
+    std::size_t display_consumer;
+    std::size_t frame = 0;
+    Rewind rewind;
+    bool rewinding = false;
+    // the ROM file loaded last, reloaded to start a recording
+    std::string rom_path;
+    std::optional<MovieRecorder> recorder;
+    std::string movie_path;
+    std::optional<MoviePlayer> player;
+    RunAhead run_ahead;
+    // instructions of the last frame, the frames ahead run as many
+    int frame_instructions = 0;
+
+    SpscQueue<Command, command_queue_size> commands;
+    std::atomic<uint16_t> keys{0};
+    TripleBuffer<Snapshot> snapshots;
+    // last member, the thread starts after everything else is initialized
+    std::jthread thread;
+};
+
+} // namespace chip8
+
+#endif// CHIP8_EMULATIONTHREAD_H
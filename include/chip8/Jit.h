@@ -0,0 +1,101 @@
+#ifndef CHIP8_JIT_H
+#define CHIP8_JIT_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace chip8 {
+
+class Chip8;
+
+/**
+ * Pointers to the machine state a compiled block works on.
+ * The layout is hard coded in the generated code.
+ */
+struct JitState {
+    uint8_t *V;
+    uint16_t *I;
+    uint16_t *PC;
+    uint8_t *delay_timer;
+    uint8_t *sound_timer;
+    Chip8 *chip8;
+};
+
+/**
+ * Jit - translates Chip8 basic blocks into x86-64 machine code.
+ *
+ * A block starts at an address and ends with the first instruction for which ends_basic_block()
+ * is true. Arithmetic, loads and timer instructions are translated to native code, all other
+ * instructions call back into the Chip8 member functions. Compiled blocks are cached by address and
+ * dropped when memory in a page containing compiled code is written.
+ *
+ * A block is called with the number of instructions it may execute and leaves early when they
+ * are used up, so blocks longer than the instructions left in a frame still run natively.
+ *
+ * Only available on x86-64 with POSIX mmap, see supported().
+ */
+class Jit {
+  public:
+    // runs at most budget (at least 1) instructions, returns the number of instructions executed
+    using BlockFn = int (*)(JitState *, int budget);
+
+    struct Block {
+        BlockFn fn = nullptr;    // nullptr if no instruction at this address could be compiled
+        uint16_t length = 0;     // number of instructions in the block, if it is not left early
+        bool compiled = false;
+    };
+
+    Jit();
+    ~Jit();
+    Jit(const Jit &) = delete;
+    Jit &operator=(const Jit &) = delete;
+    Jit(Jit &&other) noexcept;
+    Jit &operator=(Jit &&other) noexcept;
+
+    [[nodiscard]] static bool supported();
+    /**
+     * Can blocks be compiled? False if the code buffer could not be allocated or made executable.
+     */
+    [[nodiscard]] bool available() const { return buffer != nullptr; }
+
+    /**
+     * The block starting at address, compiled on first use.
+     */
+    [[nodiscard]] Block block_at(const Chip8 &chip8, uint16_t address);
+
+    /**
+     * Memory in [address, address + length) has been written. If the range touches a page containing
+     * compiled code, all blocks are dropped before the next block is looked up.
+     */
+    void invalidate(std::size_t address, std::size_t length);
+
+    /**
+     * Drop all blocks before the next block is looked up, e.g. after a quirk setting changed.
+     */
+    void reset() { flush_pending = true; }
+
+  private:
+    static constexpr std::size_t mem_size = 4096;
+    static constexpr std::size_t page_size = 256;
+    static constexpr std::size_t capacity = 256 * 1024;
+    static constexpr std::size_t max_block_length = 64;
+
+    uint8_t *buffer = nullptr;
+    std::size_t used = 0;
+    bool flush_pending = false;
+
+    std::array<Block, mem_size> blocks{};
+    std::array<bool, mem_size / page_size> code_pages{};
+
+    void flush();
+    // release the code buffer after it could not be made writable or executable
+    void disable();
+    [[nodiscard]] Block compile(const Chip8 &chip8, uint16_t address);
+    [[nodiscard]] BlockFn install(const std::vector<uint8_t> &code);
+};
+
+} // namespace chip8
+
+#endif //CHIP8_JIT_H
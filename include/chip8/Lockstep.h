@@ -0,0 +1,121 @@
+#ifndef CHIP8_LOCKSTEP_H
+#define CHIP8_LOCKSTEP_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "chip8/Chip8.h"
+#include "utilities/Random.h"
+
+namespace chip8 {
+
+/**
+ * Runs many copies of the same ROM in lockstep, e.g. with different seeds and inputs.
+ *
+ * Every lane behaves like a Chip8 that loaded the ROM and was started: each step executes one
+ * instruction with the semantics of Chip8::exec_op_cycle on every running lane. The machine state
+ * is stored as structure of arrays (register k of all lanes is contiguous), so where the lanes
+ * agree on PC and opcode the instruction is executed for all of them at once with AVX2: loads,
+ * arithmetic, skips, jumps, I and timer instructions. Lanes that diverged and all other
+ * instructions (drawing, memory, stack, keys, random numbers) run scalar per lane.
+ *
+ * Lanes share the memory image of the ROM until they write memory (FX33, FX55), then they get a
+ * copy of their own. A lane stops on a fault like Chip8, without showing the error screen.
+ * The history of executed instructions is not recorded.
+ */
+class Lockstep {
+  public:
+    static constexpr std::size_t lane_block = 32;   // lanes per AVX2 register of bytes
+
+    struct Config {
+        int cycles_per_frame = 8;
+        bool shift_vy = true;
+        std::size_t stack_depth = Chip8::default_stack_depth;
+        // use AVX2 if the CPU supports it, otherwise every lane is executed scalar
+        bool use_simd = true;
+    };
+
+    struct Stats {
+        std::size_t simd_instructions = 0;      // lane instructions executed in SIMD groups
+        std::size_t scalar_instructions = 0;
+    };
+
+    /**
+     * One lane per seed, every lane starts the ROM with its seed like Chip8::set_seed.
+     */
+    Lockstep(std::span<const uint8_t> rom, std::span<const uint64_t> seeds, const Config &t_config);
+    Lockstep(std::span<const uint8_t> rom, std::span<const uint64_t> seeds) : Lockstep(rom, seeds, Config{}) {}
+
+    [[nodiscard]] std::size_t get_lanes() const { return lanes; }
+
+    // pressed keys of a lane, bit k is key k
+    void set_keys(std::size_t lane, uint16_t pressed) { keys[lane] = pressed; }
+    [[nodiscard]] uint16_t get_keys(std::size_t lane) const { return keys[lane]; }
+
+    // One frame on all running lanes, like Chip8::tick: the timers and cycles_per_frame steps.
+    void tick();
+    void run_instructions(int count);
+    // Execute one instruction on every running lane.
+    void step();
+
+    [[nodiscard]] bool is_running(std::size_t lane) const { return running[lane] != 0; }
+    [[nodiscard]] uint16_t get_pc(std::size_t lane) const { return pc[lane]; }
+    [[nodiscard]] uint16_t get_i(std::size_t lane) const { return index[lane]; }
+    [[nodiscard]] uint8_t get_delay_timer(std::size_t lane) const { return delay_timer[lane]; }
+    [[nodiscard]] uint8_t get_sound_timer(std::size_t lane) const { return sound_timer[lane]; }
+    [[nodiscard]] std::size_t get_stack_pointer(std::size_t lane) const { return stack_pointer[lane]; }
+    [[nodiscard]] std::size_t get_tick_count(std::size_t lane) const { return tick_count[lane]; }
+    [[nodiscard]] const FaultInfo &get_fault(std::size_t lane) const { return faults[lane]; }
+    [[nodiscard]] std::array<uint8_t, Chip8::num_registers> get_registers(std::size_t lane) const;
+    [[nodiscard]] std::span<const uint8_t, Chip8::mem_size> get_memory(std::size_t lane) const;
+    [[nodiscard]] std::span<const uint64_t, Chip8::screen_height> get_display_rows(std::size_t lane) const;
+    [[nodiscard]] const Stats &get_stats() const { return stats; }
+
+  private:
+    [[nodiscard]] uint8_t &reg(std::size_t x, std::size_t lane) { return registers[x * stride + lane]; }
+    [[nodiscard]] const uint8_t *memory_of(std::size_t lane) const;
+    // the lane's own copy of the memory, created on the first write
+    [[nodiscard]] uint8_t *writable_memory(std::size_t lane);
+    [[nodiscard]] uint16_t fetch(std::size_t lane) const;
+
+    void exec_scalar(std::size_t lane);
+    // Mark the running lanes with the PC and opcode of the first running lane in group.
+    // Returns false if no lane is running.
+    bool find_group(uint16_t &group_pc, uint16_t &opcode);
+    // Execute opcode for the lanes in group, false if the instruction has no SIMD implementation.
+    bool exec_group_avx2(uint16_t group_pc, uint16_t opcode);
+
+    Config config;
+    std::size_t lanes;
+    // lanes rounded up to whole blocks, the padding lanes never run
+    std::size_t stride;
+    bool simd;
+
+    std::vector<uint8_t> registers;         // 16 * stride, register x of lane l at x * stride + l
+    std::vector<uint16_t> pc;
+    std::vector<uint16_t> index;            // I
+    std::vector<uint8_t> delay_timer;
+    std::vector<uint8_t> sound_timer;
+    std::vector<uint8_t> stack_pointer;
+    std::vector<uint16_t> stack;            // max_stack_depth per lane
+    std::vector<uint16_t> keys;
+    std::vector<uint8_t> running;           // 0xFF while the lane runs
+    std::vector<uint8_t> group;             // 0xFF for the lanes executed together in this step
+    std::vector<std::size_t> tick_count;
+    std::vector<FaultInfo> faults;
+    std::vector<Pcg32> random_generators;
+    std::vector<uint64_t> display_rows;     // 32 per lane
+
+    std::array<uint8_t, Chip8::mem_size> image{};
+    std::vector<uint8_t> own_memory;        // mem_size per lane, valid if wrote_memory
+    std::vector<uint8_t> wrote_memory;
+
+    Stats stats;
+};
+
+} // namespace chip8
+
+#endif// CHIP8_LOCKSTEP_H
@@ -0,0 +1,173 @@
+#ifndef CHIP8_MOVIE_H
+#define CHIP8_MOVIE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "chip8/Chip8.h"
+
+namespace chip8 {
+
+/**
+ * A recorded run of a ROM that replays to the identical state.
+ *
+ * A run is determined by the ROM, the quirks, the seed, the number of instructions of every frame
+ * and the keys. Key changes are stamped with the tick count (instructions executed) at which they
+ * were applied, frames with equal instruction counts are run length encoded, so a movie of a
+ * program at a constant speed takes a few bytes plus a few bytes per key change.
+ *
+ * The file format is binary: "C8MV", then version, ROM size, shift quirk, stack depth, frame runs,
+ * key changes (ticks relative to the previous change) and end tick as LEB128 numbers; ROM hash,
+ * seed and the state hash at the end as 8 bytes little endian.
+ */
+struct Movie {
+    static constexpr uint64_t current_version = 1;
+
+    // count frames in a row with the same number of instructions
+    struct FrameRun {
+        uint64_t count = 0;
+        int instructions = 0;
+
+        bool operator==(const FrameRun &) const = default;
+    };
+
+    struct KeyChange {
+        uint64_t tick = 0;
+        uint16_t keys = 0;                  // bit k is key k
+
+        bool operator==(const KeyChange &) const = default;
+    };
+
+    uint64_t rom_hash = 0;
+    uint64_t rom_size = 0;
+    uint64_t seed = 0;
+    bool shift_vy = true;
+    uint64_t stack_depth = Chip8::default_stack_depth;
+    std::vector<FrameRun> frames;
+    // sorted by tick
+    std::vector<KeyChange> key_changes;
+    // tick count and Chip8::state_hash() when the recording ended
+    uint64_t end_tick = 0;
+    uint64_t end_state_hash = 0;
+
+    [[nodiscard]] uint64_t frame_count() const;
+
+    bool write(std::ostream &out) const;
+    /**
+     * @return the movie, std::nullopt if the data is not a movie of a supported version (the error is logged)
+     */
+    [[nodiscard]] static std::optional<Movie> read(std::istream &in);
+
+    bool operator==(const Movie &) const = default;
+};
+
+/**
+ * Records the run of a Chip8 from the start of its ROM.
+ */
+class MovieRecorder {
+  public:
+    /**
+     * Start recording chip8, which has just loaded its ROM, possibly already started with
+     * toggle_pause(), but has not run an instruction.
+     */
+    explicit MovieRecorder(const Chip8 &chip8);
+
+    /**
+     * Record a frame, called right before the keys are set and chip8.tick(instructions) runs.
+     * Frames of a program that is not running are not recorded, they do not change the state.
+     */
+    void record_frame(const Chip8 &chip8, uint16_t keys, int instructions);
+    /**
+     * The movie recorded so far, ending in the current state of chip8.
+     */
+    [[nodiscard]] Movie finish(const Chip8 &chip8) const;
+
+  private:
+    Movie movie;
+};
+
+/**
+ * Replays a Movie. The keys are set at exactly the recorded instruction, a frame is split into
+ * several run_instructions() calls where necessary, so the replay is independent of the backend
+ * and of idle skipping.
+ *
+ * While playing, a save state is kept at the first frame start after every checkpoint_interval
+ * ticks. seek() restores the latest checkpoint before the target tick and replays from there, so
+ * any tick of the movie is reached in at most checkpoint_interval instructions plus a frame.
+ */
+class MoviePlayer {
+  public:
+    // about ten seconds at the default speed, a checkpoint takes sizeof(Chip8::SaveState)
+    static constexpr uint64_t default_checkpoint_interval = 5000;
+
+    explicit MoviePlayer(Movie t_movie, uint64_t t_checkpoint_interval = default_checkpoint_interval)
+            : movie(std::move(t_movie)), checkpoint_interval(std::max<uint64_t>(t_checkpoint_interval, 1)) {}
+
+    /**
+     * Prepare chip8, which has just loaded the ROM of the movie: seed, quirks and start.
+     *
+     * @return false if the loaded ROM is not the one of the movie
+     */
+    bool start(Chip8 &chip8);
+    /**
+     * Run the next frame, or the rest of the current one after a seek into it.
+     *
+     * @return false if the movie is over or the program stopped
+     */
+    bool play_frame(Chip8 &chip8);
+    /**
+     * Play until the tick count of chip8 is tick, stopping within a frame if necessary.
+     *
+     * @return false if the movie ended or the program stopped before
+     */
+    bool play_until(Chip8 &chip8, uint64_t tick);
+    /**
+     * Move chip8 to tick of the movie, forwards or backwards. chip8 has to be the one start() was
+     * called with.
+     *
+     * @return false if the movie ends or the program stops before tick
+     */
+    bool seek(Chip8 &chip8, uint64_t tick);
+    [[nodiscard]] bool finished() const { return position.run == movie.frames.size() && position.frame_left == 0; }
+    /**
+     * Did the replay end in the recorded state?
+     */
+    [[nodiscard]] bool matches(const Chip8 &chip8) const;
+    [[nodiscard]] const Movie &get_movie() const { return movie; }
+    [[nodiscard]] std::size_t checkpoints() const { return saved.size(); }
+
+  private:
+    struct Position {
+        // frame runs
+        std::size_t run = 0;
+        uint64_t frame_in_run = 0;
+        std::size_t next_key_change = 0;
+        // instructions left in the current frame, 0 at a frame start
+        int frame_left = 0;
+    };
+
+    struct Checkpoint {
+        Position position;
+        Chip8::SaveState state;
+    };
+
+    // run the current frame up to tick, a frame is started if the position is at a frame start
+    bool advance(Chip8 &chip8, uint64_t tick);
+    void checkpoint(const Chip8 &chip8);
+
+    Movie movie;
+    uint64_t checkpoint_interval;
+    Position position;
+    // sorted by tick
+    std::vector<Checkpoint> saved;
+};
+
+} // namespace chip8
+
+#endif// CHIP8_MOVIE_H
@@ -0,0 +1,54 @@
+#ifndef CHIP8_OPCODEDECODING_H
+#define CHIP8_OPCODEDECODING_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+#include "chip8/InstructionPartAccessorFunctions.h"
+
+namespace chip8 {
+
+    /**
+     * Bits of an opcode that select the operation, by the first nibble of the opcode.
+     * The other bits are operands (X, Y, N, NN, NNN).
+     */
+    inline constexpr std::array<uint16_t, 16> opcode_masks{
+            0xFFFF, 0xF000, 0xF000, 0xF000,
+            0xF000, 0xF000, 0xF000, 0xF000,
+            0xF00F, 0xF000, 0xF000, 0xF000,
+            0xF000, 0xF000, 0xF0FF, 0xF0FF
+    };
+
+    /**
+     * The opcodes of all operations with their operands set to 0, in the order of Chip8::operations.
+     */
+    inline constexpr std::array<uint16_t, 34> opcode_patterns{
+            0x00E0, 0x00EE, 0x1000, 0x2000, 0x3000, 0x4000, 0x5000, 0x6000,
+            0x7000, 0x8000, 0x8001, 0x8002, 0x8003, 0x8004, 0x8005, 0x8006,
+            0x8007, 0x800E, 0x9000, 0xA000, 0xB000, 0xC000, 0xD000, 0xE09E,
+            0xE0A1, 0xF007, 0xF00A, 0xF015, 0xF018, 0xF01E, 0xF029, 0xF033,
+            0xF055, 0xF065
+    };
+
+    /**
+     * The opcode with its operands set to 0.
+     *
+     * @param opcode a Chip8 opcode
+     */
+    [[nodiscard]] constexpr uint16_t opcode_pattern(uint16_t opcode) {
+        return static_cast<uint16_t>(opcode & opcode_masks[get4Bit(opcode, 12)]);
+    }
+
+    /**
+     * Is there an operation for the opcode? Executing any other opcode faults.
+     *
+     * @param opcode a Chip8 opcode
+     */
+    [[nodiscard]] constexpr bool is_valid_opcode(uint16_t opcode) {
+        return std::ranges::find(opcode_patterns, opcode_pattern(opcode)) != opcode_patterns.end();
+    }
+
+}
+
+#endif //CHIP8_OPCODEDECODING_H
@@ -0,0 +1,54 @@
+#ifndef CHIP8_PIXELEXPANSION_H
+#define CHIP8_PIXELEXPANSION_H
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+/**
+ * Expansion of the 1 bit per pixel display rows into 8 bit and RGBA8 images.
+ *
+ * The kernels are selected once at runtime: AVX2 and SSE2 on x86-64 (SSE2 is always available
+ * there), a table driven scalar version everywhere else.
+ */
+namespace chip8::pixels {
+
+    enum class Kernel{ Scalar, Sse2, Avx2 };
+
+    struct Rgba {
+        uint8_t r = 0;
+        uint8_t g = 0;
+        uint8_t b = 0;
+        uint8_t a = 0xFF;
+    };
+
+    struct Palette {
+        Rgba off{0x00, 0x00, 0x00, 0xFF};
+        Rgba on{0xFF, 0xFF, 0xFF, 0xFF};
+    };
+
+    // The fastest kernel supported by the CPU.
+    [[nodiscard]] Kernel best_kernel();
+
+    /**
+     * Write 64 bytes per row, 0xFF for a set bit and 0x00 otherwise. Byte j of a row is bit j,
+     * i.e. the pixels of a row go from right to left.
+     *
+     * @param rows display rows, the most significant bit is the leftmost pixel
+     * @param out 64 * rows.size() bytes
+     * @param kernel implementation to use, has to be supported by the CPU
+     */
+    void expand_rows(std::span<const uint64_t> rows, std::span<uint8_t> out, Kernel kernel = best_kernel());
+
+    /**
+     * Write 64 RGBA8 pixels per row, top left first.
+     *
+     * @param rows display rows, the most significant bit is the leftmost pixel
+     * @param out 4 * 64 * rows.size() bytes
+     */
+    void expand_rows_rgba(std::span<const uint64_t> rows, std::span<uint8_t> out, const Palette &palette,
+                          Kernel kernel = best_kernel());
+
+} // namespace chip8::pixels
+
+#endif //CHIP8_PIXELEXPANSION_H
@@ -0,0 +1,100 @@
+#ifndef CHIP8_REWIND_H
+#define CHIP8_REWIND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "chip8/Chip8.h"
+
+namespace chip8 {
+
+/**
+ * Rewind history of a Chip8: a saved state per frame, restored newest first.
+ *
+ * Every keyframe_interval frames the complete Chip8::SaveState is stored, the frames in between
+ * as run length encoded XOR with the previous frame, which is mostly zero. XOR works both ways:
+ * stepping back from the newest frame applies its delta to the newest state, only stepping back
+ * over a keyframe replays the deltas following the keyframe before it.
+ *
+ * Everything is stored in an arena allocated once, capturing a frame never allocates. When the
+ * arena or the frame index is full, the oldest keyframe and its deltas are dropped.
+ */
+class Rewind {
+  public:
+    struct Config {
+        std::size_t keyframe_interval = 60;             // one keyframe per second
+        std::size_t arena_bytes = std::size_t{16} << 20U;
+        std::size_t max_frames = 60 * 60 * 10;          // ten minutes
+    };
+
+    struct Stats {
+        std::size_t frames = 0;
+        std::size_t keyframes = 0;
+        std::size_t bytes = 0;                          // stored in the arena
+        std::size_t arena_bytes = 0;
+        double capture_nanoseconds = 0;                 // average time capture() took
+
+        // arena bytes one minute of rewind takes at the current compression
+        [[nodiscard]] double bytes_per_minute() const {
+            static constexpr double frames_per_minute = 60.0 * 60.0;
+            return frames == 0 ? 0.0 : static_cast<double>(bytes) * frames_per_minute / static_cast<double>(frames);
+        }
+    };
+
+    explicit Rewind(const Config &t_config);
+    Rewind() : Rewind(Config{}) {}
+
+    /**
+     * Store the state of the chip8 as the newest frame, call after every frame.
+     */
+    void capture(const Chip8 &chip8);
+    /**
+     * Drop the newest frame and load the frame before it into the chip8.
+     *
+     * @return false if there is no earlier frame, the chip8 is unchanged then
+     */
+    bool step_back(Chip8 &chip8);
+    void clear();
+
+    [[nodiscard]] std::size_t frames() const { return count; }
+    [[nodiscard]] Stats get_stats() const;
+
+  private:
+    struct Entry {
+        uint32_t offset = 0;
+        uint32_t size = 0;
+        bool keyframe = false;
+    };
+
+    // index 0 is the oldest frame
+    [[nodiscard]] Entry &entry(std::size_t index) { return entries[(oldest + index) % entries.size()]; }
+    // offset of length free bytes, drops old frames if necessary
+    [[nodiscard]] std::size_t allocate(std::size_t length);
+    void push(const Entry &new_entry);
+    void drop_oldest();
+    // drop the oldest keyframe and the deltas depending on it
+    void drop_oldest_keyframe();
+
+    Config config;
+    std::vector<uint8_t> arena;
+    std::vector<Entry> entries;
+    std::size_t oldest = 0;
+    std::size_t count = 0;
+    // end of the newest frame in the arena
+    std::size_t tail = 0;
+    std::size_t since_keyframe = 0;
+    std::size_t keyframes = 0;
+    std::size_t stored_bytes = 0;
+
+    // the state of the newest frame
+    Chip8::SaveState newest;
+    Chip8::SaveState scratch;
+
+    uint64_t captures = 0;
+    uint64_t capture_nanoseconds = 0;
+};
+
+} // namespace chip8
+
+#endif// CHIP8_REWIND_H
@@ -0,0 +1,57 @@
+#ifndef CHIP8_RUNAHEAD_H
+#define CHIP8_RUNAHEAD_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "chip8/Chip8.h"
+
+namespace chip8 {
+
+/**
+ * Hides the input lag of a ROM by showing frames that have not happened yet.
+ *
+ * Most programs react to a key a frame or more after it is pressed: they poll the keys once per
+ * frame or wait for the delay timer first. For every presented frame the state is saved, frames
+ * more frames are run with the current keys, the display of the last one is shown and the state
+ * is restored. The emulation itself stays where it was, a key press shows up frames earlier.
+ *
+ * The cost is frames times a frame of emulation plus a save and a load of Chip8::SaveState, the
+ * average is measured to pick the number of frames per ROM: as few as hide the lag of the ROM.
+ * The instruction history is restored with the state, faults of the frames ahead are not logged.
+ */
+class RunAhead {
+  public:
+    static constexpr int max_frames = 8;
+
+    explicit RunAhead(int t_frames = 0) { set_frames(t_frames); }
+
+    // 0 disables run-ahead, clamped to max_frames
+    void set_frames(int t_frames);
+    [[nodiscard]] int get_frames() const { return frames; }
+
+    /**
+     * Run the frames ahead of chip8 with instructions per frame, copy their display into rows and
+     * restore chip8. The rows that differ from the display of chip8 are added to dirty_rows, the
+     * restore marks them again for the display consumer, so the next frame redraws them.
+     *
+     * @return false if nothing was run: run-ahead is disabled or the program is not running
+     */
+    bool run(Chip8 &chip8, int instructions, std::size_t display_consumer, Chip8::DisplayRows &rows,
+             Chip8::DirtyRows &dirty_rows);
+
+    // average time of a run(), including save and restore
+    [[nodiscard]] double get_nanoseconds() const;
+    void reset_measurement();
+
+  private:
+    int frames = 0;
+    Chip8::SaveState saved;
+    Chip8::History history;
+    uint64_t runs = 0;
+    uint64_t nanoseconds = 0;
+};
+
+} // namespace chip8
+
+#endif// CHIP8_RUNAHEAD_H
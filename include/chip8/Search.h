@@ -0,0 +1,70 @@
+#ifndef CHIP8_SEARCH_H
+#define CHIP8_SEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "chip8/Batch.h"
+#include "chip8/Chip8.h"
+
+/**
+ * Breadth first search for the shortest key sequence that brings a program from a save state to
+ * a goal, e.g. a memory value or a screen.
+ *
+ * At every decision point the search branches into no key and each of the 16 keys, held for
+ * frames_per_step frames. States are identified by a hash of their Chip8::SaveState without the
+ * tick count, a state reached before is not expanded again; programs spending most frames in wait
+ * loops collapse into few states. Each level is expanded in two parallel passes over the states: the first one hashes
+ * the children and checks the goal, the second one, after the duplicates have been removed in
+ * order, keeps the states of the new children. The search is deterministic for any number of
+ * threads and finds the first shortest path in key order.
+ */
+namespace chip8::search {
+
+    // a decision point branches into no key and each of the 16 keys, in this order
+    inline constexpr std::size_t branches = 17;
+
+    struct Config {
+        Backend backend = Backend::Interpreter;
+        bool idle_skipping = true;
+        // frames the keys of a decision are held
+        std::size_t frames_per_step = 1;
+        std::size_t max_steps = 120;
+        // distinct states the search may visit, a state takes sizeof(Chip8::SaveState) while it is expanded
+        std::size_t max_states = 100'000;
+        unsigned threads = std::thread::hardware_concurrency();
+    };
+
+    struct Result {
+        bool found = false;
+        // the keys of every step, from the start to the goal
+        std::vector<uint16_t> path;
+        std::size_t states = 0;         // distinct states visited
+        std::size_t steps = 0;          // levels searched
+        std::size_t frames = 0;         // frames run, including the pass keeping the states
+    };
+
+    // called from several threads at once
+    using Goal = std::function<bool(const Chip8 &)>;
+
+    /**
+     * Search from start, a state of a Chip8 running rom, for the shortest path to a state the goal
+     * holds for. Programs that stopped are not expanded further.
+     */
+    [[nodiscard]] Result find_shortest_path(std::span<const uint8_t> rom, const Chip8::SaveState &start,
+                                            const Goal &goal, const Config &config);
+
+    /**
+     * The key changes of a path as input script for chip8_batch, see batch::parse_input().
+     * first_frame is the frame of the first step, the keys are released after the last one.
+     */
+    [[nodiscard]] std::vector<batch::InputEvent> to_input(std::span<const uint16_t> path, std::size_t first_frame,
+                                                          std::size_t frames_per_step);
+
+} // namespace chip8::search
+
+#endif// CHIP8_SEARCH_H
@@ -8,14 +8,13 @@
 #include <imgui.h>
 #include <imfilebrowser.h>
 
-#include "chip8/Chip8.h"
+#include "chip8/EmulationThread.h"
 
 
 class GUI {
   public:
-    GUI(GLFWwindow *window, chip8::Chip8 &t_chip8);
+    GUI(GLFWwindow *window, chip8::EmulationThread &t_emulation);
     void render(uint32_t texture);
-    [[nodiscard]] int get_instructions_per_iteration() const { return cycles_per_frame; }
 
     ~GUI();
     GUI(const GUI&) = delete;
@@ -25,8 +24,9 @@ class GUI {
   private:
     void resetWindow();
     GLFWwindow *window_;
-    chip8::Chip8& chip8;
-    int cycles_per_frame = 10;
+    // the GUI only reads the snapshots of the emulation and changes it through commands
+    chip8::EmulationThread& emulation;
+    int instructions_per_second;
 
     ImGui::FileBrowser file_dialog;
     ImFont* monospace;
@@ -39,6 +39,10 @@ class GUI {
     bool fixed_aspect_ratio = true;
 
     bool shift_implementation_vy = true;
+    int backend = 0;
+    int run_ahead_frames = 0;
+    bool rewind_held = false;
+    uint64_t seek_tick = 0;
 
     std::string game_path{};
 
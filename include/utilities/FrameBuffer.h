@@ -1,42 +1,8 @@
-#ifndef CHIP8_SIMPLEDISPLAYTEXTURE_H
-#define CHIP8_SIMPLEDISPLAYTEXTURE_H
+#ifndef CHIP8_FRAMEBUFFER_H
+#define CHIP8_FRAMEBUFFER_H
 
 #include <GL/glew.h>
-#include "chip8/Chip8.h"
-
-
-class SimpleDisplayTexture {
-    using Chip8Texture = std::array<uint8_t, chip8::Chip8::screen_size>;
-
-public:
-    SimpleDisplayTexture() {
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        // set the texture wrapping parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-        // set texture filtering parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    }
-
-    void load_texture(const chip8::Chip8 &chip8) const {
-        static constexpr int texture_width = chip8::Chip8::screen_width;
-        static constexpr int texture_height = chip8::Chip8::screen_height;
-        Chip8Texture texture_data = chip8.get_screen();
-
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexImage2D(
-                GL_TEXTURE_2D, 0, GL_RED, texture_width, texture_height,
-                0, GL_RED, GL_UNSIGNED_BYTE, texture_data.data());
-//        glBindTexture(GL_TEXTURE_2D, 0);
-    }
-
-    [[nodiscard]] GLuint get_texture() const { return texture; }
-
-private:
-    GLuint texture{};
-};
+#include <spdlog/spdlog.h>
 
 
 class FrameBuffer {
@@ -91,4 +57,4 @@ private:
     GLuint fbo_texture{};
 };
 
-#endif //CHIP8_SIMPLEDISPLAYTEXTURE_H
+#endif //CHIP8_FRAMEBUFFER_H
@@ -0,0 +1,19 @@
+#ifndef CHIP8_HASH_H
+#define CHIP8_HASH_H
+
+#include <cstdint>
+#include <span>
+
+// 64 bit FNV-1a hash, used to identify ROMs and to compare emulator states.
+static constexpr uint64_t fnv1a_offset_basis = 0xcbf29ce484222325ULL;
+static constexpr uint64_t fnv1a_prime = 0x100000001b3ULL;
+
+[[nodiscard]] constexpr uint64_t fnv1a(std::span<const uint8_t> data, uint64_t hash = fnv1a_offset_basis) {
+    for (const auto byte: data) {
+        hash ^= byte;
+        hash *= fnv1a_prime;
+    }
+    return hash;
+}
+
+#endif// CHIP8_HASH_H
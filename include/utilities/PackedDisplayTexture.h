@@ -0,0 +1,142 @@
+#ifndef CHIP8_PACKEDDISPLAYTEXTURE_H
+#define CHIP8_PACKEDDISPLAYTEXTURE_H
+
+#include <array>
+#include <bit>
+#include <cstring>
+#include <optional>
+
+#include <GL/glew.h>
+#include "chip8/Chip8.h"
+#include "chip8/EmulationThread.h"
+
+/**
+ * Display texture holding 1 bit per pixel, unpacked by the fragment shader.
+ *
+ * The 32 display rows are uploaded unchanged into an 8x32 GL_R8UI texture: texel (i >> 3, row)
+ * bit (i & 7) is the pixel 63 - i of the row (see res/shaders/fragmentShader.glsl). The storage
+ * is allocated once, immutable if ARB_texture_storage is available, and every frame only
+ * replaces its 256 bytes with glTexSubImage2D. With ARB_buffer_storage the upload goes through a
+ * ring of persistently mapped pixel buffers, so the driver never has to copy or wait.
+ */
+class PackedDisplayTexture {
+    static constexpr int texture_width = chip8::Chip8::screen_width / 8;
+    static constexpr int texture_height = chip8::Chip8::screen_height;
+    static constexpr GLsizeiptr frame_bytes = sizeof(chip8::Chip8::DisplayRows);
+    static constexpr std::size_t ring_size = 3;
+
+public:
+    explicit PackedDisplayTexture(bool use_pixel_buffers = true) {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        // integer textures cannot be filtered
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (GLEW_ARB_texture_storage) {
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8UI, texture_width, texture_height);
+        } else {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, texture_width, texture_height, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+        }
+
+        if (use_pixel_buffers && GLEW_ARB_buffer_storage) {
+            static constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glGenBuffers(1, &pixel_buffer);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer);
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, frame_bytes * ring_size, nullptr, flags);
+            mapped = static_cast<uint8_t *>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, frame_bytes * ring_size, flags));
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+    }
+
+    ~PackedDisplayTexture() {
+        for (auto &fence: fences) { glDeleteSync(fence); }
+        if (pixel_buffer != 0) {
+            if (mapped != nullptr) {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer);
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            }
+            glDeleteBuffers(1, &pixel_buffer);
+        }
+        glDeleteTextures(1, &texture);
+    }
+    PackedDisplayTexture(PackedDisplayTexture &) = delete;
+    PackedDisplayTexture(PackedDisplayTexture &&) = delete;
+    PackedDisplayTexture operator=(PackedDisplayTexture &) = delete;
+    PackedDisplayTexture operator=(PackedDisplayTexture &&) = delete;
+
+    // upload the rows that changed since the last call
+    void load_texture(chip8::Chip8 &chip8) {
+        if (!consumer) { consumer = chip8.add_display_consumer(); }
+        upload_rows(chip8.get_display_rows(), chip8.take_dirty_rows(*consumer));
+    }
+
+    // upload the rows of a frame published by the emulation thread, everything if frames were skipped
+    void load_texture(const chip8::Snapshot &snapshot) {
+        if (last_frame && snapshot.frame == *last_frame) { return; }
+        const auto consecutive = last_frame && snapshot.frame == *last_frame + 1;
+        upload_rows(snapshot.display_rows, consecutive ? snapshot.dirty_rows : chip8::Chip8::all_rows_dirty);
+        last_frame = snapshot.frame;
+    }
+
+    [[nodiscard]] GLuint get_texture() const { return texture; }
+
+private:
+    void upload_rows(const chip8::Chip8::DisplayRows &display_rows, chip8::Chip8::DirtyRows dirty) {
+        if (dirty == 0) { return; }
+        // one upload from the first to the last changed row
+        const auto first = std::countr_zero(dirty);
+        const auto count = texture_height - std::countl_zero(dirty << (64 - texture_height)) - first;
+        const auto first_byte = static_cast<GLsizeiptr>(first) * texture_width;
+        const auto bytes = static_cast<std::size_t>(count) * texture_width;
+
+        const auto *rows = packed_rows(display_rows);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        if (mapped == nullptr) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, texture_width, count, GL_RED_INTEGER, GL_UNSIGNED_BYTE, rows + first_byte);
+            return;
+        }
+
+        // the slot was last used ring_size frames ago, its upload is practically always finished
+        auto &fence = fences[slot];
+        if (fence != nullptr) {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(fence);
+        }
+        const auto offset = frame_bytes * static_cast<GLsizeiptr>(slot) + first_byte;
+        std::memcpy(mapped + offset, rows + first_byte, bytes);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, texture_width, count, GL_RED_INTEGER, GL_UNSIGNED_BYTE,
+                        reinterpret_cast<const void *>(offset)); // NOLINT offset into the bound buffer
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot = (slot + 1) % ring_size;
+    }
+
+    // texel byte k of a row holds the pixels 63 - 8k - 7 .. 63 - 8k, least significant bit first,
+    // which is the memory layout of the rows on little endian machines
+    const uint8_t *packed_rows(const chip8::Chip8::DisplayRows &rows) {
+        if constexpr (std::endian::native == std::endian::little) {
+            return reinterpret_cast<const uint8_t *>(rows.data()); // NOLINT the rows are uploaded as bytes
+        } else {
+            for (std::size_t idx = 0; idx < converted.size(); idx++) {
+                converted[idx] = static_cast<uint8_t>(rows[idx / 8] >> (8 * (idx % 8)));
+            }
+            return converted.data();
+        }
+    }
+
+    GLuint texture{};
+    GLuint pixel_buffer{};
+    uint8_t *mapped = nullptr;
+    std::array<GLsync, ring_size> fences{};
+    std::size_t slot = 0;
+    std::array<uint8_t, frame_bytes> converted{};
+    std::optional<std::size_t> consumer;
+    std::optional<std::size_t> last_frame;
+};
+
+#endif //CHIP8_PACKEDDISPLAYTEXTURE_H
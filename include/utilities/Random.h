@@ -0,0 +1,49 @@
+#ifndef CHIP8_RANDOM_H
+#define CHIP8_RANDOM_H
+
+#include <cstdint>
+
+/**
+ * PCG32 (XSH RR) random number generator, see https://www.pcg-random.org.
+ *
+ * 16 bytes of state, a multiply and an add per number. The complete state can be read and
+ * restored, the same seed and stream always produce the same sequence.
+ */
+class Pcg32 {
+  public:
+    static constexpr uint64_t default_stream = 0xda3e39cb94b95bdbULL;
+
+    struct State {
+        uint64_t state = 0;
+        uint64_t increment = 0;
+
+        constexpr bool operator==(const State &) const = default;
+    };
+
+    constexpr explicit Pcg32(uint64_t seed = 0, uint64_t stream = default_stream) { reseed(seed, stream); }
+
+    constexpr void reseed(uint64_t seed, uint64_t stream = default_stream) {
+        current = {0, (stream << 1U) | 1U};
+        next();
+        current.state += seed;
+        next();
+    }
+
+    constexpr uint32_t next() {
+        const auto old = current.state;
+        current.state = old * multiplier + current.increment;
+        const auto xorshifted = static_cast<uint32_t>(((old >> 18U) ^ old) >> 27U);
+        const auto rotation = static_cast<uint32_t>(old >> 59U);
+        return (xorshifted >> rotation) | (xorshifted << ((0U - rotation) & 31U));
+    }
+
+    [[nodiscard]] constexpr State get_state() const { return current; }
+    constexpr void set_state(const State &state) { current = state; }
+
+  private:
+    static constexpr uint64_t multiplier = 6364136223846793005ULL;
+
+    State current;
+};
+
+#endif// CHIP8_RANDOM_H
@@ -0,0 +1,82 @@
+#ifndef CHIP8_RINGBUFFER_H
+#define CHIP8_RINGBUFFER_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iterator>
+
+/**
+ * Fixed-capacity ring buffer that keeps the last Capacity pushed elements.
+ *
+ * Storage is inline and pushing never allocates. Iteration and operator[] go from the newest to
+ * the oldest element. Capacity has to be a power of two, so wrapping around is a mask.
+ */
+template<typename T, std::size_t Capacity>
+class RingBuffer {
+    static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+  public:
+    class const_iterator {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T *;
+        using reference = const T &;
+
+        const_iterator() = default;
+        const_iterator(const RingBuffer *t_buffer, std::size_t t_index) : buffer(t_buffer), index(t_index) {}
+
+        reference operator*() const { return (*buffer)[index]; }
+        pointer operator->() const { return &(*buffer)[index]; }
+        const_iterator &operator++() {
+            index++;
+            return *this;
+        }
+        const_iterator operator++(int) {
+            auto copy = *this;
+            index++;
+            return copy;
+        }
+        bool operator==(const const_iterator &other) const { return index == other.index; }
+
+      private:
+        const RingBuffer *buffer = nullptr;
+        std::size_t index = 0;
+    };
+
+    void push(const T &value) {
+        data[head & mask] = value;
+        head++;
+        if (count < Capacity) { count++; }
+    }
+
+    void clear() {
+        head = 0;
+        count = 0;
+    }
+
+    // index 0 is the newest element
+    [[nodiscard]] const T &operator[](std::size_t index) const { return data[(head - 1 - index) & mask]; }
+
+    [[nodiscard]] std::size_t size() const { return count; }
+    [[nodiscard]] bool empty() const { return count == 0; }
+    [[nodiscard]] static constexpr std::size_t capacity() { return Capacity; }
+
+    [[nodiscard]] const_iterator begin() const { return {this, 0}; }
+    [[nodiscard]] const_iterator end() const { return {this, count}; }
+
+    friend bool operator==(const RingBuffer &lhs, const RingBuffer &rhs) {
+        return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+    }
+
+  private:
+    static constexpr std::size_t mask = Capacity - 1;
+
+    std::array<T, Capacity> data{};
+    std::size_t head = 0;
+    std::size_t count = 0;
+};
+
+#endif// CHIP8_RINGBUFFER_H
@@ -0,0 +1,48 @@
+#ifndef CHIP8_SPSCQUEUE_H
+#define CHIP8_SPSCQUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <optional>
+
+/**
+ * Bounded lock-free queue for one producer and one consumer thread.
+ *
+ * Capacity has to be a power of two. push() fails instead of blocking when the queue is full.
+ */
+template<typename T, std::size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+  public:
+    // producer side
+    bool push(T value) {
+        const auto tail = write_index.load(std::memory_order_relaxed);
+        if (tail - read_index.load(std::memory_order_acquire) == Capacity) { return false; }
+        slots[tail & mask] = std::move(value);
+        write_index.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side
+    std::optional<T> pop() {
+        const auto head = read_index.load(std::memory_order_relaxed);
+        if (head == write_index.load(std::memory_order_acquire)) { return std::nullopt; }
+        std::optional<T> value{std::move(slots[head & mask])};
+        read_index.store(head + 1, std::memory_order_release);
+        return value;
+    }
+
+  private:
+    static constexpr std::size_t mask = Capacity - 1;
+    // keep the indices of producer and consumer on different cache lines
+    static constexpr std::size_t cache_line = 64;
+
+    std::array<T, Capacity> slots{};
+    alignas(cache_line) std::atomic<std::size_t> write_index{0};
+    alignas(cache_line) std::atomic<std::size_t> read_index{0};
+};
+
+#endif// CHIP8_SPSCQUEUE_H
@@ -0,0 +1,45 @@
+#ifndef CHIP8_TRIPLEBUFFER_H
+#define CHIP8_TRIPLEBUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Lock-free triple buffer for handing the latest value from one writer thread to one reader thread.
+ *
+ * The writer fills write_buffer() and publishes it, the reader calls update() and reads
+ * read_buffer(). Neither side ever waits: the writer always has a buffer of its own, the reader
+ * always sees the last completely written value and values published in between are dropped.
+ */
+template<typename T>
+class TripleBuffer {
+  public:
+    TripleBuffer() = default;
+    explicit TripleBuffer(const T &initial) : buffers{initial, initial, initial} {}
+
+    // writer side
+    [[nodiscard]] T &write_buffer() { return buffers[back]; }
+    void publish() {
+        back = middle.exchange(static_cast<uint8_t>(back | fresh_bit), std::memory_order_acq_rel) & index_mask;
+    }
+
+    // reader side: switch to the latest published value, returns false if there is none
+    bool update() {
+        if ((middle.load(std::memory_order_relaxed) & fresh_bit) == 0) { return false; }
+        front = middle.exchange(front, std::memory_order_acq_rel) & index_mask;
+        return true;
+    }
+    [[nodiscard]] const T &read_buffer() const { return buffers[front]; }
+
+  private:
+    static constexpr uint8_t fresh_bit = 0x4;
+    static constexpr uint8_t index_mask = 0x3;
+
+    std::array<T, 3> buffers{};
+    uint8_t back = 0;
+    std::atomic<uint8_t> middle{1};
+    uint8_t front = 2;
+};
+
+#endif// CHIP8_TRIPLEBUFFER_H
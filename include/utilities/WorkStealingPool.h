@@ -0,0 +1,112 @@
+#ifndef CHIP8_WORKSTEALINGPOOL_H
+#define CHIP8_WORKSTEALINGPOOL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/**
+ * Runs independent tasks on a fixed number of threads with work stealing.
+ *
+ * The task indices are split into one contiguous range per worker. A worker takes tasks from the
+ * back of its own range; when it runs dry it steals the front half of the range of another
+ * worker. Every range has its own lock, which is only contended while stealing, so the pool scales
+ * with the number of threads even for many short tasks.
+ */
+class WorkStealingPool {
+  public:
+    explicit WorkStealingPool(unsigned t_threads = std::thread::hardware_concurrency())
+            : threads(std::max(t_threads, 1U)) {}
+
+    [[nodiscard]] unsigned get_threads() const { return threads; }
+
+    /**
+     * Call task(index) for every index in [0, count) and wait until all calls returned.
+     * Tasks run concurrently, in no particular order. The first exception thrown by a task is
+     * rethrown after all workers stopped.
+     */
+    template<typename Task>
+    void run(std::size_t count, Task &&task) {
+        const auto workers = std::min<std::size_t>(threads, std::max<std::size_t>(count, 1));
+        std::vector<Range> ranges(workers);
+        for (std::size_t worker = 0; worker < workers; worker++) {
+            ranges[worker].begin = worker * count / workers;
+            ranges[worker].end = (worker + 1) * count / workers;
+        }
+
+        std::exception_ptr failure;
+        std::mutex failure_mutex;
+        const auto work = [&](std::size_t worker) {
+            try {
+                while (true) {
+                    const auto index = ranges[worker].pop();
+                    if (index) {
+                        task(*index);
+                    } else if (!steal(ranges, worker)) {
+                        // tasks never create new tasks, all ranges are empty
+                        return;
+                    }
+                }
+            } catch (...) {
+                const std::lock_guard lock(failure_mutex);
+                if (!failure) { failure = std::current_exception(); }
+                // the remaining tasks of the worker are dropped
+                ranges[worker].clear();
+            }
+        };
+
+        std::vector<std::thread> pool;
+        pool.reserve(workers - 1);
+        for (std::size_t worker = 1; worker < workers; worker++) { pool.emplace_back(work, worker); }
+        work(0);
+        for (auto &thread: pool) { thread.join(); }
+        if (failure) { std::rethrow_exception(failure); }
+    }
+
+  private:
+    // a range of task indices, aligned so the locks of different workers do not share a cache line
+    struct alignas(64) Range {
+        std::mutex mutex;
+        std::size_t begin = 0;
+        std::size_t end = 0;
+
+        std::optional<std::size_t> pop() {
+            const std::lock_guard lock(mutex);
+            if (begin == end) { return std::nullopt; }
+            return --end;
+        }
+        void clear() {
+            const std::lock_guard lock(mutex);
+            begin = end;
+        }
+    };
+
+    // move the front half of the first non empty range of another worker to worker
+    static bool steal(std::vector<Range> &ranges, std::size_t worker) {
+        for (std::size_t offset = 1; offset < ranges.size(); offset++) {
+            auto &victim = ranges[(worker + offset) % ranges.size()];
+            std::size_t begin = 0;
+            std::size_t end = 0;
+            {
+                const std::lock_guard lock(victim.mutex);
+                if (victim.begin == victim.end) { continue; }
+                begin = victim.begin;
+                end = begin + (victim.end - victim.begin + 1) / 2;
+                victim.begin = end;
+            }
+            const std::lock_guard lock(ranges[worker].mutex);
+            ranges[worker].begin = begin;
+            ranges[worker].end = end;
+            return true;
+        }
+        return false;
+    }
+
+    unsigned threads;
+};
+
+#endif// CHIP8_WORKSTEALINGPOOL_H
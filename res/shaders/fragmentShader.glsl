@@ -2,11 +2,14 @@
 out vec4 FragColor;
 
 in vec2 TexCoord;
-uniform sampler2D Texture;
+// 8x32 texels, bit b of texel (t, row) is the pixel 63 - (8 * t + b) of the display row
+uniform usampler2D Texture;
 
 void main()
 {
-    vec4 color = texture(Texture, TexCoord);
-    float on = color.r;
+    int i = min(int(TexCoord.x * 64.0), 63);
+    int row = 31 - min(int(TexCoord.y * 32.0), 31);
+    uint bits = texelFetch(Texture, ivec2(i >> 3, row), 0).r;
+    float on = float((bits >> uint(i & 7)) & 1u);
     FragColor = on * vec4(0.7 * TexCoord.x, 0.8 * TexCoord.y, 0.9, 1.0) + 0.1;
 }
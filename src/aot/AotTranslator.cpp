@@ -0,0 +1,179 @@
+#include "chip8/AotTranslator.h"
+
+#include <map>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "chip8/Aot.h"
+#include "chip8/BasicBlock.h"
+#include "chip8/InstructionPartAccessorFunctions.h"
+#include "chip8/OpcodeDecoding.h"
+#include "chip8/OpcodeToString.h"
+#include "utilities/Hash.h"
+
+namespace chip8::aot {
+
+    namespace {
+        struct Instruction {
+            uint16_t address;
+            uint16_t opcode;
+        };
+
+        struct TranslatedBlock {
+            std::vector<Instruction> instructions;
+            uint16_t end = 0;
+            bool terminated = false;
+        };
+
+        class Rom {
+          public:
+            explicit Rom(std::span<const uint8_t> t_data) : data(t_data) {}
+
+            // is the whole instruction at address inside the ROM
+            [[nodiscard]] bool contains(uint16_t address) const {
+                return address >= Chip8::pc_start_address
+                       && address + 2U <= Chip8::pc_start_address + data.size()
+                       && address + 4U <= Chip8::mem_size; // incPC saturates at the end of memory
+            }
+
+            [[nodiscard]] uint16_t opcode(uint16_t address) const {
+                const auto offset = std::size_t{address} - Chip8::pc_start_address;
+                return static_cast<uint16_t>((data[offset] << 8U) | data[offset + 1]);
+            }
+
+          private:
+            std::span<const uint8_t> data;
+        };
+
+        // addresses execution can continue at after the block terminator at address
+        std::vector<uint16_t> successors(uint16_t address, uint16_t opcode) {
+            const auto next = static_cast<uint16_t>(address + 2);
+            switch (get4Bit(opcode, 12)) {
+                case 0x1: return {nnn(opcode)};
+                case 0x2: return {nnn(opcode), next};
+                case 0x3:
+                case 0x4:
+                case 0x5:
+                case 0x9:
+                case 0xE: return {next, static_cast<uint16_t>(next + 2)};
+                case 0xF: return nn(opcode) == 0x0A ? std::vector{address, next} : std::vector{next};
+                default: return {}; // 00EE returns to the address after a call, BNNN is indirect
+            }
+        }
+
+        // recover the basic blocks reachable from the start address
+        std::map<uint16_t, TranslatedBlock> recover_blocks(const Rom &rom) {
+            std::map<uint16_t, TranslatedBlock> blocks;
+            std::vector<uint16_t> work{Chip8::pc_start_address};
+            while (!work.empty()) {
+                const auto start = work.back();
+                work.pop_back();
+                if (blocks.contains(start) || !rom.contains(start)) { continue; }
+
+                TranslatedBlock block;
+                auto pc = start;
+                while (block.instructions.size() < max_block_length && rom.contains(pc)) {
+                    const auto opcode = rom.opcode(pc);
+                    if (!is_valid_opcode(opcode)) { break; }
+                    block.instructions.push_back({pc, opcode});
+                    pc = static_cast<uint16_t>(pc + 2);
+                    if (ends_basic_block(opcode)) {
+                        block.terminated = true;
+                        const auto next = successors(static_cast<uint16_t>(pc - 2), opcode);
+                        work.insert(work.end(), next.begin(), next.end());
+                        break;
+                    }
+                }
+                if (block.instructions.empty()) { continue; }
+                if (!block.terminated) { work.push_back(pc); }
+                block.end = pc;
+                blocks.emplace(start, std::move(block));
+            }
+            return blocks;
+        }
+
+        // C++ statements for an instruction, uses V, I and PC of the generated block function
+        std::string translate(const Instruction &instruction) {
+            const auto opcode = instruction.opcode;
+            const auto x = X(opcode);
+            const auto y = Y(opcode);
+            const uint16_t mask = masks[get4Bit(opcode, 12)];
+            switch (opcode & mask) {
+                case 0x1000: return fmt::format("PC = 0x{:03X};", nnn(opcode));
+                case 0x6000: return fmt::format("V[0x{:X}] = 0x{:02X};", x, nn(opcode));
+                case 0x7000: return fmt::format("V[0x{:X}] = static_cast<uint8_t>(V[0x{:X}] + 0x{:02X});", x, x, nn(opcode));
+                case 0x8000: return fmt::format("V[0x{:X}] = V[0x{:X}];", x, y);
+                case 0x8001: return fmt::format("V[0x{0:X}] = static_cast<uint8_t>(V[0x{0:X}] | V[0x{1:X}]);", x, y);
+                case 0x8002: return fmt::format("V[0x{0:X}] = static_cast<uint8_t>(V[0x{0:X}] & V[0x{1:X}]);", x, y);
+                case 0x8003: return fmt::format("V[0x{0:X}] = static_cast<uint8_t>(V[0x{0:X}] ^ V[0x{1:X}]);", x, y);
+                case 0x8004:
+                    return fmt::format("{{ const auto vx = V[0x{0:X}]; V[0x{0:X}] = static_cast<uint8_t>(vx + V[0x{1:X}]); "
+                                       "V[0xF] = static_cast<uint8_t>(vx > V[0x{0:X}]); }}", x, y);
+                case 0x8005:
+                    return fmt::format("{{ const auto vx = V[0x{0:X}]; V[0x{0:X}] = static_cast<uint8_t>(vx - V[0x{1:X}]); "
+                                       "V[0xF] = static_cast<uint8_t>(vx >= V[0x{0:X}]); }}", x, y);
+                case 0x8007:
+                    return fmt::format("{{ const auto vy = V[0x{1:X}]; V[0x{0:X}] = static_cast<uint8_t>(vy - V[0x{0:X}]); "
+                                       "V[0xF] = static_cast<uint8_t>(vy >= V[0x{0:X}]); }}", x, y);
+                case 0x8006:
+                    return fmt::format("{{ const std::size_t src = Access::shift_vy(chip8) ? 0x{1:X}U : 0x{0:X}U; "
+                                       "V[0xF] = static_cast<uint8_t>(V[src] & 1U); V[0x{0:X}] = static_cast<uint8_t>(V[src] >> 1U); }}", x, y);
+                case 0x800E:
+                    return fmt::format("{{ const std::size_t src = Access::shift_vy(chip8) ? 0x{1:X}U : 0x{0:X}U; "
+                                       "V[0xF] = static_cast<uint8_t>(V[src] >> 7U); V[0x{0:X}] = static_cast<uint8_t>(V[src] << 1U); }}", x, y);
+                case 0xA000: return fmt::format("I = 0x{:03X};", nnn(opcode));
+                case 0xF007: return fmt::format("V[0x{:X}] = Access::delay_timer(chip8);", x);
+                case 0xF015: return fmt::format("Access::delay_timer(chip8) = V[0x{:X}];", x);
+                case 0xF018: return fmt::format("Access::sound_timer(chip8) = V[0x{:X}];", x);
+                case 0xF01E: return fmt::format("I = static_cast<uint16_t>(I + V[0x{:X}]);", x);
+                case 0xF029: return fmt::format("I = static_cast<uint16_t>(5U * (V[0x{:X}] & 0xFU));", x);
+                default:
+                    return fmt::format("PC = 0x{:03X}; Access::exec(chip8, 0x{:04X});", instruction.address + 2, opcode);
+            }
+        }
+
+        std::string translate(uint16_t start, const TranslatedBlock &block) {
+            std::string body;
+            for (const auto &instruction: block.instructions) {
+                body += fmt::format("        // {:04X}: {:04X}  {}\n", instruction.address, instruction.opcode,
+                                    opcode_to_assembler(instruction.opcode));
+                body += fmt::format("        {}\n", translate(instruction));
+            }
+            if (!block.terminated) { body += fmt::format("        PC = 0x{:03X};\n", block.end); }
+
+            std::string declarations;
+            if (body.find("V[") != std::string::npos) { declarations += "        auto &V = Access::V(chip8);\n"; }
+            if (body.find("I = ") != std::string::npos) { declarations += "        auto &I = Access::I(chip8);\n"; }
+            declarations += "        auto &PC = Access::PC(chip8);\n";
+
+            return fmt::format("    void block_{:04X}(chip8::Chip8 &chip8) {{\n{}{}    }}\n\n", start, declarations, body);
+        }
+    }
+
+
+    std::string translate_rom(std::span<const uint8_t> rom, std::string_view rom_name) {
+        const auto blocks = recover_blocks(Rom{rom});
+
+        std::string source = fmt::format(
+                "// Generated by chip8_aot from {}. Do not edit.\n"
+                "#include <array>\n"
+                "#include <cstdint>\n\n"
+                "#include \"chip8/Aot.h\"\n\n"
+                "namespace {{\n"
+                "    using chip8::aot::Access;\n\n", rom_name);
+
+        for (const auto &[start, block]: blocks) { source += translate(start, block); }
+
+        source += fmt::format("    constexpr std::array<chip8::aot::Block, {}> blocks{{{{\n", blocks.size());
+        for (const auto &[start, block]: blocks) {
+            source += fmt::format("        {{0x{0:04X}, {1}, 0x{2:04X}, &block_{0:04X}}},\n", start, block.instructions.size(), block.end);
+        }
+        source += "    }};\n\n";
+        source += fmt::format("    constexpr chip8::aot::CompiledRom compiled_rom{{0x{:016X}ULL, {}, blocks}};\n", fnv1a(rom), rom.size());
+        source += "    const chip8::aot::Registration registration{compiled_rom};\n";
+        source += "}\n";
+        return source;
+    }
+
+} // namespace chip8::aot
@@ -0,0 +1,42 @@
+// chip8_aot - statically recompile a Chip8 ROM into a C++ translation unit.
+//
+// usage: chip8_aot <rom.ch8> <output.cpp>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "chip8/AotTranslator.h"
+#include "chip8/Chip8.h"
+
+int main(int argc, char **argv) {
+    const std::vector<std::string> args(argv, argv + argc);
+    if (args.size() != 3) {
+        spdlog::error("usage: chip8_aot <rom.ch8> <output.cpp>");
+        return 1;
+    }
+
+    std::ifstream rom_file(args[1], std::ios::binary);
+    if (!rom_file) {
+        spdlog::error("Could not open file: {}", args[1]);
+        return 1;
+    }
+    rom_file >> std::noskipws;
+    const std::vector<uint8_t> rom((std::istream_iterator<uint8_t>(rom_file)), std::istream_iterator<uint8_t>());
+    if (rom.size() > chip8::Chip8::mem_size - chip8::Chip8::pc_start_address) {
+        spdlog::error("ROM too big: {} bytes", rom.size());
+        return 1;
+    }
+
+    const auto source = chip8::aot::translate_rom(rom, std::filesystem::path(args[1]).filename().string());
+    std::ofstream output(args[2]);
+    output << source;
+    if (!output) {
+        spdlog::error("Could not write file: {}", args[2]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+// chip8_batch - run the jobs of a manifest on all cores, see chip8/Batch.h for the manifest format.
+//
+// usage: chip8_batch <manifest> <results.jsonl> [--threads N]
+//
+// Writes one line of JSON per job to the results file, in the order the jobs finish.
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "chip8/Batch.h"
+
+int main(int argc, char **argv) {
+    const std::vector<std::string> args(argv, argv + argc);
+    auto threads = std::thread::hardware_concurrency();
+    if (args.size() == 5 && args[3] == "--threads") {
+        try {
+            threads = static_cast<unsigned>(std::stoul(args[4]));
+        } catch (const std::logic_error &) {
+            threads = 0;
+        }
+    }
+    if ((args.size() != 3 && args.size() != 5) || threads == 0) {
+        spdlog::error("usage: chip8_batch <manifest> <results.jsonl> [--threads N]");
+        return 1;
+    }
+
+    std::ifstream manifest(args[1]);
+    if (!manifest) {
+        spdlog::error("Could not open file: {}", args[1]);
+        return 1;
+    }
+    const auto jobs = chip8::batch::parse_manifest(manifest, std::filesystem::path(args[1]).parent_path());
+    if (!jobs) { return 1; }
+
+    std::ofstream output(args[2]);
+    if (!output) {
+        spdlog::error("Could not write file: {}", args[2]);
+        return 1;
+    }
+
+    std::size_t instructions = 0;
+    std::size_t faults = 0;
+    const auto start = std::chrono::steady_clock::now();
+    chip8::batch::run(*jobs, threads, [&](const chip8::batch::Result &result) {
+        output << chip8::batch::to_json((*jobs)[result.job], result) << '\n';
+        instructions += result.instructions;
+        if (result.fault.fault != chip8::Fault::None) { faults++; }
+    });
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    spdlog::info("{} jobs on {} threads in {:.3f} s: {:.1f} jobs/s, {:.0f} instructions/s, {} faults",
+                 jobs->size(), threads, seconds, static_cast<double>(jobs->size()) / seconds,
+                 static_cast<double>(instructions) / seconds, faults);
+    if (!output) {
+        spdlog::error("Could not write file: {}", args[2]);
+        return 1;
+    }
+    return 0;
+}
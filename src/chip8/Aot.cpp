@@ -0,0 +1,34 @@
+#include "chip8/Aot.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace chip8::aot {
+
+    // registration happens during static initialization, the registry must exist before
+    static std::vector<const CompiledRom *> &registry() {
+        static std::vector<const CompiledRom *> roms;
+        return roms;
+    }
+
+
+    void register_rom(const CompiledRom &rom) {
+        registry().push_back(&rom);
+    }
+
+
+    const CompiledRom *find_rom(uint64_t rom_hash, std::size_t rom_size) {
+        const auto &roms = registry();
+        const auto itr = std::find_if(roms.begin(), roms.end(), [&](const auto *rom) {
+            return rom->rom_hash == rom_hash && rom->rom_size == rom_size;
+        });
+        return itr != roms.end() ? *itr : nullptr;
+    }
+
+
+    void Access::exec(Chip8 &chip8, uint16_t opcode) {
+        std::invoke(Chip8::fetch_op(opcode), chip8, opcode);
+    }
+
+} // namespace chip8::aot
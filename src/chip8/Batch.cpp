@@ -0,0 +1,187 @@
+#include "chip8/Batch.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include "utilities/Hash.h"
+#include "utilities/WorkStealingPool.h"
+
+namespace chip8::batch {
+
+    std::optional<std::vector<InputEvent>> parse_input(std::istream &script) {
+        std::vector<InputEvent> events;
+        std::string line;
+        for (std::size_t line_number = 1; std::getline(script, line); line_number++) {
+            if (line.empty() || line.front() == '#') { continue; }
+            std::istringstream fields(line);
+            InputEvent event;
+            unsigned key = 0;
+            std::string action;
+            if (!(fields >> event.frame >> std::hex >> key >> action) || key > 0xF || (action != "down" && action != "up")) {
+                spdlog::error("Invalid input event in line {}: {}", line_number, line);
+                return std::nullopt;
+            }
+            event.key = static_cast<uint8_t>(key);
+            event.pressed = action == "down";
+            events.push_back(event);
+        }
+        std::ranges::stable_sort(events, {}, &InputEvent::frame);
+        return events;
+    }
+
+
+    std::optional<std::vector<Job>> parse_manifest(std::istream &manifest, const std::filesystem::path &base) {
+        // jobs running the same ROM share it
+        std::map<std::filesystem::path, std::shared_ptr<const std::vector<uint8_t>>> roms;
+        std::map<std::filesystem::path, std::vector<InputEvent>> inputs;
+
+        std::vector<Job> jobs;
+        std::string line;
+        for (std::size_t line_number = 1; std::getline(manifest, line); line_number++) {
+            if (line.find_first_not_of(" \t") == std::string::npos || line.front() == '#') { continue; }
+            const auto invalid = [&](const std::string &reason) {
+                spdlog::error("Invalid job in line {}: {}", line_number, reason);
+                return std::nullopt;
+            };
+
+            Job job;
+            job.name = std::to_string(line_number);
+            std::istringstream fields(line);
+            for (std::string field; fields >> field;) {
+                const auto separator = field.find('=');
+                if (separator == std::string::npos) { return invalid(field); }
+                const auto key = field.substr(0, separator);
+                const auto value = field.substr(separator + 1);
+                try {
+                    if (key == "name") {
+                        job.name = value;
+                    } else if (key == "rom") {
+                        const auto path = base / value;
+                        auto &rom = roms[path];
+                        if (!rom) {
+                            std::ifstream rom_file(path, std::ios::binary);
+                            if (!rom_file) { return invalid(fmt::format("could not open {}", path.string())); }
+                            rom_file >> std::noskipws;
+                            rom = std::make_shared<const std::vector<uint8_t>>(std::istream_iterator<uint8_t>(rom_file),
+                                                                               std::istream_iterator<uint8_t>());
+                            if (rom->size() > Chip8::mem_size - Chip8::pc_start_address) { return invalid("ROM too big"); }
+                        }
+                        job.rom = rom;
+                    } else if (key == "input") {
+                        const auto path = base / value;
+                        if (!inputs.contains(path)) {
+                            std::ifstream script(path);
+                            if (!script) { return invalid(fmt::format("could not open {}", path.string())); }
+                            auto events = parse_input(script);
+                            if (!events) { return invalid(fmt::format("invalid input script {}", path.string())); }
+                            inputs[path] = std::move(*events);
+                        }
+                        job.input = inputs[path];
+                    } else if (key == "frames") {
+                        job.frames = std::stoull(value);
+                    } else if (key == "cycles") {
+                        job.cycles_per_frame = std::max(std::stoi(value), 1);
+                    } else if (key == "backend") {
+                        const auto backend = parse_backend(value);
+                        if (!backend) { return invalid(field); }
+                        job.backend = *backend;
+                    } else if (key == "shift") {
+                        if (value != "vx" && value != "vy") { return invalid(field); }
+                        job.shift_vy = value == "vy";
+                    } else if (key == "stack") {
+                        job.stack_depth = std::stoull(value);
+                    } else if (key == "seed") {
+                        job.seed = std::stoull(value, nullptr, 0);
+                    } else if (key == "idle") {
+                        job.idle_skipping = value != "0";
+                    } else if (key == "hashes") {
+                        job.record_frame_hashes = value != "0";
+                    } else {
+                        return invalid(field);
+                    }
+                } catch (const std::logic_error &) {
+                    return invalid(field);
+                }
+            }
+            if (!job.rom) { return invalid("no rom"); }
+            jobs.push_back(std::move(job));
+        }
+        return jobs;
+    }
+
+
+    Result run_job(const Job &job, std::size_t index) {
+        // over 200 KB of decoded instructions and block tables, too big for the stack of a worker
+        const auto chip8 = std::make_unique<Chip8>();
+        chip8->set_seed(job.seed);
+        chip8->set_backend(job.backend);
+        chip8->set_shift_implementation(job.shift_vy);
+        chip8->set_stack_depth(job.stack_depth);
+        chip8->set_idle_skipping(job.idle_skipping);
+        chip8->cycles_per_frame = job.cycles_per_frame;
+        chip8->load_rom(*job.rom);
+        chip8->toggle_pause();
+
+        Result result;
+        result.job = index;
+        if (job.record_frame_hashes) { result.frame_hashes.reserve(job.frames); }
+        auto event = job.input.begin();
+        for (; result.frames < job.frames && chip8->get_state() == State::Running; result.frames++) {
+            for (; event != job.input.end() && event->frame <= result.frames; ++event) {
+                chip8->keys[event->key] = event->pressed;
+            }
+            chip8->tick();
+            if (job.record_frame_hashes) { result.frame_hashes.push_back(fnv1a(chip8->get_display_buffer())); }
+        }
+        result.instructions = chip8->get_tick_count();
+        result.state_hash = chip8->state_hash();
+        result.fault = chip8->get_fault();
+        return result;
+    }
+
+
+    void run(std::span<const Job> jobs, unsigned threads, const std::function<void(const Result &)> &on_result) {
+        std::mutex result_mutex;
+        WorkStealingPool(threads).run(jobs.size(), [&](std::size_t index) {
+            const auto result = run_job(jobs[index], index);
+            const std::lock_guard lock(result_mutex);
+            on_result(result);
+        });
+    }
+
+
+    static std::string escape_json(const std::string &text) {
+        std::string escaped;
+        for (const auto character: text) {
+            if (character == '"' || character == '\\') { escaped += '\\'; }
+            escaped += character;
+        }
+        return escaped;
+    }
+
+
+    std::string to_json(const Job &job, const Result &result) {
+        auto json = fmt::format(R"({{"job": {}, "name": "{}", "frames": {}, "instructions": {}, "state_hash": "{:016X}")",
+                                result.job, escape_json(job.name), result.frames, result.instructions, result.state_hash);
+        if (result.fault.fault != Fault::None) {
+            json += fmt::format(R"(, "fault": "{}", "fault_pc": "{:03X}", "fault_opcode": "{:04X}")",
+                                fault_name(result.fault.fault), result.fault.pc, result.fault.opcode);
+        }
+        if (job.record_frame_hashes) {
+            json += R"(, "frame_hashes": [)";
+            for (std::size_t frame = 0; frame < result.frame_hashes.size(); frame++) {
+                json += fmt::format(R"({}"{:016X}")", frame == 0 ? "" : ", ", result.frame_hashes[frame]);
+            }
+            json += "]";
+        }
+        return json + "}";
+    }
+
+} // namespace chip8::batch
@@ -1,18 +1,25 @@
 #include "chip8/Chip8.h"
 
 #include <algorithm>
-#include <bitset>
+#include <bit>
+#include <cstring>
 #include <fstream>
 #include <functional>
 #include <iterator>
 #include <random>
 #include <ranges>
+#include <span>
+#include <type_traits>
+#include <utility>
 
+#include <fmt/format.h>
 #include <gsl/narrow>
 #include <spdlog/spdlog.h>
 
-#include "utilities/Map.h"
+#include "chip8/Aot.h"
 #include "chip8/InstructionPartAccessorFunctions.h"
+#include "chip8/OpcodeDecoding.h"
+#include "utilities/Hash.h"
 
 
 namespace chip8 {
@@ -21,9 +28,17 @@ namespace chip8 {
     static constexpr auto sprite_size = int{5};
     static constexpr auto bytes_in_screen = 8 * Chip8::screen_height;
     static constexpr auto F = int{0xF};
-    static constexpr auto xFF = 0xFFU;
     static constexpr auto program_start = uint16_t{512};
 
+    // rows of 64 pixels from the byte-wise display representation
+    static constexpr Chip8::DisplayRows to_display_rows(const std::array<uint8_t, bytes_in_screen> &bytes) {
+        Chip8::DisplayRows rows{};
+        for (std::size_t idx = 0; idx < bytes.size(); idx++) {
+            rows[idx / 8] = (rows[idx / 8] << 8U) | bytes[idx];
+        }
+        return rows;
+    }
+
     // sprites
     static constexpr std::array<uint8_t, 80> fontset = {{
             0xF0, 0x90, 0x90, 0x90, 0xF0,  // 0
@@ -44,17 +59,17 @@ namespace chip8 {
             0xF0, 0x80, 0xF0, 0x80, 0x80   // F
     }};
 
-    std::mt19937 getRandomGenerator() {
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        return gen;
-    }
-
-    static auto random_generator = getRandomGenerator(); // NOLINT if it throws, app crashes
-
     Chip8::Chip8() {
         ranges::copy(fontset, memory.begin());
         op_clear_screen(0);
+        std::random_device random_device;
+        set_seed((uint64_t{random_device()} << 32U) | random_device());
+    }
+
+
+    void Chip8::set_seed(uint64_t t_seed) {
+        seed = t_seed;
+        random_generator.reseed(seed);
     }
 
 
@@ -66,6 +81,7 @@ namespace chip8 {
                                      (std::istream_iterator<uint8_t>()));
             ranges::copy(rom, memory.begin() + program_start);
             program_size = rom.size();
+            rom_loaded();
             reset();
         } else {
             // TODO give user error message
@@ -80,27 +96,166 @@ namespace chip8 {
 
 
     void Chip8::exec_op_cycle() {
-        const auto opcode = gsl::narrow_cast<uint16_t>((memory[PC] << 8) | memory[PC + 1]); // NOLINT (cppcoreguidelines-pro-bounds-constant-array-index)
+        auto &entry = decoded[PC];
+        if (entry.op == nullptr) { entry = decode(PC); }
+        // copy, the operation may invalidate the entry
+        const auto op = entry.op;
+        const auto opcode = entry.opcode;
+        const auto address = PC;
         incPC();
-        const auto op = fetch_op(opcode);
         std::invoke(op, this, opcode);
-        call_stack.push_front(opcode);
-        if (call_stack.size() > call_stack_size) { call_stack.pop_back(); }
+        if (faulted()) [[unlikely]] {
+            stop_on_fault(address);
+            return;
+        }
+        retire(address, opcode);
+    }
+
+
+    void Chip8::retire(uint16_t address, uint16_t opcode) {
+        call_stack.push({address, opcode});
         tick_count++;
     }
 
 
+    void Chip8::run_interpreter(int cycles) {
+        auto remaining = cycles;
+        while (remaining > 0 && !faulted()) {
+            const auto &entry = decoded[PC];
+            if (idle_skipping && entry.idle) {
+                if (const auto length = idle_loop_length(PC); length != 0) {
+                    skip_idle_loop(length, remaining);
+                    return;
+                }
+            }
+            // a superinstruction is only used if all of its instructions fit into the frame
+            if (superinstructions && entry.fused != nullptr && entry.fused_length <= remaining) {
+                remaining -= std::invoke(entry.fused, this, PC);
+            } else {
+                exec_op_cycle();
+                remaining--;
+            }
+        }
+    }
+
+
+    void Chip8::rom_loaded() {
+        invalidate_decoded(program_start, program_size);
+        fuse_superinstructions();
+
+        aot_blocks.fill(nullptr);
+        const auto rom = std::span(memory).subspan(program_start, std::min(program_size, mem_size - std::size_t{program_start}));
+        rom_hash = fnv1a(rom);
+        const auto *compiled = aot::find_rom(rom_hash, program_size);
+        recompiled_rom = compiled != nullptr;
+        if (compiled != nullptr) {
+            for (const auto &block: compiled->blocks) { aot_blocks[block.address] = &block; }
+        }
+    }
+
+
+    // Superinstructions are only recognized on even addresses inside the ROM, far enough from the end
+    // of memory that incPC never saturates. They are dropped with the decoded instruction when
+    // memory they span is written.
+    void Chip8::fuse_superinstructions() {
+        const auto end = std::min(std::size_t{program_start} + program_size, std::size_t{mem_size} - 8);
+        for (auto address = std::size_t{program_start}; address + 2 * max_fused_length <= end; address += 2) {
+            const auto addr = gsl::narrow_cast<uint16_t>(address);
+            const auto first = read_opcode(addr);
+            const auto second = read_opcode(addr + 2);
+            const auto third = read_opcode(addr + 4);
+            const auto is_skip_vx_nn = [](uint16_t opcode) {
+                return get4Bit(opcode, 12) == 0x3 || get4Bit(opcode, 12) == 0x4;
+            };
+            const auto is_goto = [](uint16_t opcode) { return get4Bit(opcode, 12) == 0x1; };
+            const auto same_x = X(first) == X(second);
+
+            auto &entry = decoded[address];
+            entry = decode(addr);
+            if (get4Bit(first, 12) == 0x7 && is_skip_vx_nn(second) && same_x && is_goto(third)) {
+                entry.fused = &Chip8::fused_counted_loop;
+                entry.fused_length = 3;
+            } else if (get4Bit(first, 12) == 0x6 && get4Bit(second, 12) == 0xA && get4Bit(third, 12) == 0xD) {
+                entry.fused = &Chip8::fused_draw_sprite;
+                entry.fused_length = 3;
+            } else if ((first & 0xF0FFU) == 0xF007 && is_skip_vx_nn(second) && same_x) {
+                entry.fused = &Chip8::fused_poll_delay_timer;
+                entry.fused_length = 2;
+            } else if (is_skip_vx_nn(first) && is_goto(second)) {
+                entry.fused = &Chip8::fused_skip_goto;
+                entry.fused_length = 2;
+            }
+        }
+    }
+
+
+    // 3XNN/4XNN followed by 1NNN
+    int Chip8::fused_skip_goto(uint16_t address) {
+        const auto skip = read_opcode(address);
+        retire(address, skip);
+        if ((V[X(skip)] == nn(skip)) == (get4Bit(skip, 12) == 0x3)) {
+            PC = address + 4;
+            return 1;
+        }
+        const auto jump = read_opcode(address + 2);
+        PC = nnn(jump);
+        retire(address + 2, jump);
+        return 2;
+    }
+
+
+    // FX07 followed by 3XNN/4XNN
+    int Chip8::fused_poll_delay_timer(uint16_t address) {
+        const auto load = read_opcode(address);
+        const auto skip = read_opcode(address + 2);
+        V[X(load)] = delay_timer;
+        PC = (V[X(skip)] == nn(skip)) == (get4Bit(skip, 12) == 0x3) ? address + 6 : address + 4;
+        retire(address, load);
+        retire(address + 2, skip);
+        return 2;
+    }
+
+
+    // 6XNN, ANNN, DXYN
+    int Chip8::fused_draw_sprite(uint16_t address) {
+        const auto load = read_opcode(address);
+        const auto load_i = read_opcode(address + 2);
+        const auto draw = read_opcode(address + 4);
+        V[X(load)] = nn(load);
+        I = nnn(load_i);
+        PC = address + 6;
+        op_draw(draw);
+        retire(address, load);
+        retire(address + 2, load_i);
+        retire(address + 4, draw);
+        return 3;
+    }
+
+
+    // 7XNN followed by 3XNN/4XNN and 1NNN
+    int Chip8::fused_counted_loop(uint16_t address) {
+        const auto add = read_opcode(address);
+        V[X(add)] += nn(add);
+        retire(address, add);
+        return 1 + fused_skip_goto(address + 2);
+    }
+
+
     // clear screen
     void Chip8::op_clear_screen(uint16_t) { // NOLINT opcode is not needed
-        ranges::fill(display_buffer, 0);
+        display_rows = {};
+        dirty_rows = all_rows_dirty;
         draw_flag = true;
     }
 
 
     // return from subroutine
-    void Chip8::op_return_from_subroutine(uint16_t) { // NOLINT opcode is not needed
-        PC = stack.top();
-        stack.pop();
+    void Chip8::op_return_from_subroutine(uint16_t opcode) {
+        if (stack_pointer == 0) {
+            raise_fault(Fault::StackUnderflow, opcode);
+            return;
+        }
+        PC = stack[--stack_pointer];
     }
 
 
@@ -112,7 +267,11 @@ namespace chip8 {
 
     // jumps to subroutinge
     void Chip8::op_call_subroutine(uint16_t opcode) {
-        stack.push(PC);
+        if (stack_pointer == stack_depth) {
+            raise_fault(Fault::StackOverflow, opcode);
+            return;
+        }
+        stack[stack_pointer++] = PC;
         PC = nnn(opcode);
     }
 
@@ -247,14 +406,14 @@ namespace chip8 {
 
     // Jumps to the address NNN plus V0.
     void Chip8::op_goto_I_plus_v0(uint16_t opcode) {
-        PC = nnn(opcode) + V[0];
+        PC = (nnn(opcode) + V[0]) & address_mask;
     }
 
 
     // Sets Vx to the result of a bitwise and operation on a random number (Typically: 0 to 255) and NN.
     void Chip8::op_and_rand(uint16_t opcode) {
-        std::uniform_int_distribution<int> distrib(0, xFF);
-        const auto random_number = gsl::narrow_cast<uint8_t>(distrib(random_generator) & 0xFF);
+        // the high bits of PCG32 are the best ones
+        const auto random_number = gsl::narrow_cast<uint8_t>(random_generator.next() >> 24U);
         const auto val = nn(opcode);
         V[X(opcode)] = random_number & val;
     }
@@ -271,32 +430,17 @@ namespace chip8 {
         const auto vy = V[Y(opcode)] % screen_height;
         const auto N = static_cast<int>(n(opcode));
 
-        const auto byte = vx / 8;
-        const auto offset = vx % 8;
-
-        bool flipped = false;
-        // what is happening here
+        uint64_t collisions = 0;
         for (int line = 0; line < N; line++) {
-            const auto index = static_cast<uint32_t>(I + line);
-            const auto sprite_line = memory[index];
-
-            // sprites that don't fit on the screen wrap around the screen (show on the other end).
-            const auto left_byte_idx = gsl::narrow_cast<uint8_t>(byte + ((vy + line) % 32) * 8);
-            const auto old_left = display_buffer[left_byte_idx];
-            display_buffer[left_byte_idx] = old_left ^ (sprite_line >> offset);
-            if (old_left & (~display_buffer[left_byte_idx])) { // NOLINT (readability-implicit-bool-conversion)
-                flipped = true;
-            }
-
-            // sprites that don't fit on the screen wrap around the screen (show on the other end).
-            const auto right_byte_idx = gsl::narrow_cast<uint8_t>((byte + 1) % 8 + ((vy + line) % 32) * 8);
-            const auto old_right = display_buffer[right_byte_idx];
-            display_buffer[right_byte_idx] = (old_right ^ ((sprite_line << (8 - offset)) & 0xFF));
-            if (old_right & (~display_buffer[right_byte_idx])) { // NOLINT (readability-implicit-bool-conversion)
-                flipped = true;
-            }
+            // move the sprite line to the leftmost byte, rotating wraps it around the right edge
+            const auto sprite_line = std::rotr(uint64_t{memory[(I + line) & address_mask]} << 56U, vx);
+            auto &row = display_rows[static_cast<std::size_t>(vy + line) % screen_height];
+            collisions |= row & sprite_line;
+            row ^= sprite_line;
         }
-        V[F] = static_cast<uint8_t>(flipped);
+        // the rows vy to vy + N - 1, wrapping around at the bottom
+        dirty_rows |= std::rotl((uint32_t{1} << N) - 1, vy);
+        V[F] = static_cast<uint8_t>(collisions != 0);
         draw_flag = true;
     }
 
@@ -373,9 +517,10 @@ namespace chip8 {
     // the middle digit at I plus 1, and the least significant digit at I plus 2.
     void Chip8::op_vx_to_BCD(uint16_t opcode) {
         const auto vx = V[X(opcode)];
-        memory[I] = vx / 100;
-        memory[I + 1] = (vx % 100) / 10;
-        memory[I + 2] = vx % 10;
+        memory[I & address_mask] = vx / 100;
+        memory[(I + 1) & address_mask] = (vx % 100) / 10;
+        memory[(I + 2) & address_mask] = vx % 10;
+        invalidate_decoded(I & address_mask, 3);
     }
 
 
@@ -384,7 +529,8 @@ namespace chip8 {
     // I is set to I + X + 1 after operation --> see https://github.com/mattmikolay/chip-8/wiki/CHIP%E2%80%908-Instruction-Set
     void Chip8::op_regdump(uint16_t opcode) {
         const uint16_t x = X(opcode) + 1;
-        ranges::copy_n(V.begin(), x, memory.begin() + I);
+        for (uint16_t k = 0; k < x; k++) { memory[(I + k) & address_mask] = V[k]; }
+        invalidate_decoded(I & address_mask, x);
         I += x;
     }
 
@@ -394,48 +540,214 @@ namespace chip8 {
     // I is set to I + X + 1 after operation --> see https://github.com/mattmikolay/chip-8/wiki/CHIP%E2%80%908-Instruction-Set
     void Chip8::op_regload(uint16_t opcode) {
         const uint16_t x = X(opcode) + 1;
-        std::copy_n(memory.begin() + I, x, V.begin());
+        for (uint16_t k = 0; k < x; k++) { V[k] = memory[(I + k) & address_mask]; }
         I += x;
     }
 
 
+    // Every opcode not listed in operations.
+    void Chip8::op_invalid(uint16_t opcode) {
+        raise_fault(Fault::InvalidOpcode, opcode);
+    }
+
+
+    // Build the index into operations for all 2^16 opcodes at compile time.
+    consteval Chip8::OpIndexTable Chip8::make_op_index_table() {
+        // the tools decode opcodes with OpcodeDecoding.h, it has to agree with operations
+        static_assert(ranges::equal(operations | std::views::keys, opcode_patterns));
+
+        OpIndexTable table{};
+        std::fill(table.begin(), table.end(), uint8_t{num_opcodes});
+        for (uint8_t idx = 0; const auto &operation: operations) {
+            // enumerate every value of the variable nibbles of this operation
+            const auto pattern = operation.first;
+            const auto variable_bits = static_cast<uint16_t>(~opcode_masks[get4Bit(pattern, 12)]);
+            uint16_t bits = 0;
+            do {
+                table[pattern | bits] = idx;
+                bits = static_cast<uint16_t>((bits - variable_bits) & variable_bits);
+            } while (bits != 0);
+            idx++;
+        }
+        return table;
+    }
+
+
+    constexpr Chip8::OpIndexTable Chip8::op_index_table = make_op_index_table();
+
+
+    // Build the dispatch table for all 2^16 opcodes at compile time, so decoding an
+    // opcode at runtime is a single indexed load.
+    consteval Chip8::DispatchTable Chip8::make_dispatch_table() {
+        DispatchTable table{};
+        for (std::size_t opcode = 0; opcode < table.size(); opcode++) {
+            const auto idx = op_index_table[opcode];
+            table[opcode] = idx == num_opcodes ? &Chip8::op_invalid : operations[idx].second;
+        }
+        return table;
+    }
+
+
     Chip8::MFP Chip8::fetch_op(uint16_t opcode) {
-        // masks is used to hide the variable parts of opcodes, so the opcode can be
-        // looked up in operations
-        static constexpr auto masks = std::array<uint16_t, 16>{
-                0xFFFF, 0xF000, 0xF000, 0xF000,
-                0xF000, 0xF000, 0xF000, 0xF000,
-                0xF00F, 0xF000, 0xF000, 0xF000,
-                0xF000, 0xF000, 0xF0FF, 0xF0FF
-        };
-        static constexpr auto map = Map<uint16_t, MFP, num_opcodes>{{operations}}; // NOLINT
+        static constexpr auto dispatch_table = make_dispatch_table();
+        return dispatch_table[opcode];
+    }
+
 
-        const auto idx = get4Bit(opcode, 12);
-        const auto mask = masks[idx];
-        const auto op = map.at(opcode & mask);
-        return op;
+    uint16_t Chip8::read_opcode(uint16_t address) const {
+        return gsl::narrow_cast<uint16_t>((memory[address & address_mask] << 8) | memory[(address + 1) & address_mask]); // NOLINT (cppcoreguidelines-pro-bounds-constant-array-index)
+    }
+
+
+    Chip8::DecodedOp Chip8::decode(uint16_t address) const {
+        const auto opcode = read_opcode(address);
+        const auto idle = (opcode & 0xF0FFU) == 0xF00A || (opcode & 0xF0FFU) == 0xF007 || opcode == (0x1000U | address);
+        return {fetch_op(opcode), opcode, nullptr, 0, idle};
+    }
+
+
+    // The state inside a frame only changes through instructions: the keys and the delay timer
+    // are constant, so a loop that does not exit now spins until the end of the frame.
+    int Chip8::idle_loop_length(uint16_t address) const {
+        const auto first = read_opcode(address);
+        if ((first & 0xF0FFU) == 0xF00A) {
+            return std::ranges::none_of(keys, std::identity{}) ? 1 : 0;
+        }
+        if (first == (0x1000U | address)) { return 1; }
+        if ((first & 0xF0FFU) != 0xF007) { return 0; }
+        // FX07, skip on the delay timer, jump back
+        const auto skip = read_opcode(address + 2);
+        const auto jump = read_opcode(address + 4);
+        const auto is_skip_vx_nn = get4Bit(skip, 12) == 0x3 || get4Bit(skip, 12) == 0x4;
+        if (!is_skip_vx_nn || X(skip) != X(first) || jump != (0x1000U | address)) { return 0; }
+        const auto skipped = (delay_timer == nn(skip)) == (get4Bit(skip, 12) == 0x3);
+        return skipped ? 0 : 3;
+    }
+
+
+    void Chip8::skip_idle_loop(int length, int instructions) {
+        // a loop that is not entered does not read the delay timer either
+        if (instructions <= 0) { return; }
+        const auto start = PC;
+        const auto loop_address = [start](int idx) { return gsl::narrow_cast<uint16_t>((start + 2 * idx) & address_mask); };
+        if (length == 3) { V[X(read_opcode(start))] = delay_timer; }
+        // only the interpreter records the history
+        if (backend == Backend::Interpreter) {
+            for (auto idx = std::max(instructions - history_size, 0); idx < instructions; idx++) {
+                const auto address = loop_address(idx % length);
+                call_stack.push({address, read_opcode(address)});
+            }
+        }
+        tick_count += static_cast<std::size_t>(instructions);
+        PC = loop_address(instructions % length);
+    }
+
+
+    // Instructions and superinstructions starting before address may overlap the range as well.
+    // Ranges running past the end of memory wrap around to address 0.
+    void Chip8::invalidate_decoded(std::size_t address, std::size_t length) {
+        static constexpr std::size_t overlap = 2 * max_fused_length - 1;
+        const auto last = std::min(address + length, decoded.size());
+        const auto first = std::min(address < overlap ? 0 : address - overlap, last);
+        std::fill(decoded.begin() + static_cast<std::ptrdiff_t>(first),
+                  decoded.begin() + static_cast<std::ptrdiff_t>(last), DecodedOp{});
+        // the instruction at the last address reads its second byte from address 0
+        if (address == 0) { decoded.back() = DecodedOp{}; }
+        if (jit) { jit->invalidate(address, last - address); }
+        invalidate_aot(address, last - address);
+        if (address + length > decoded.size()) { invalidate_decoded(0, address + length - decoded.size()); }
+    }
+
+
+    // Recompiled blocks overlapping written memory are interpreted from now on.
+    void Chip8::invalidate_aot(std::size_t address, std::size_t length) {
+        if (!recompiled_rom) { return; }
+        static constexpr auto max_block_bytes = 2 * aot::max_block_length;
+        const auto last = std::min(address + length, aot_blocks.size());
+        for (auto start = address < max_block_bytes ? 0 : address - max_block_bytes; start < last; start++) {
+            if (aot_blocks[start] != nullptr && aot_blocks[start]->end > address) { aot_blocks[start] = nullptr; }
+        }
+    }
+
+
+    void Chip8::run_aot(int cycles) {
+        auto remaining = cycles;
+        while (remaining > 0 && !faulted()) {
+            const auto *block = aot_blocks[PC];
+            if (block != nullptr && block->length <= remaining) {
+                block->fn(*this);
+                if (faulted()) [[unlikely]] {
+                    // only block terminators can fault, the faulting instruction is not counted
+                    tick_count += block->length - 1U;
+                    stop_on_fault(gsl::narrow_cast<uint16_t>(block->address + 2 * (block->length - 1)));
+                    return;
+                }
+                tick_count += block->length;
+                remaining -= block->length;
+            } else {
+                exec_op_cycle();
+                remaining--;
+            }
+        }
+    }
+
+
+    void Chip8::run_jit(int cycles) {
+        if (!jit || !jit->available()) {
+            run_interpreter(cycles);
+            return;
+        }
+        JitState jit_state{V.data(), &I, &PC, &delay_timer, &sound_timer, this};
+        auto remaining = cycles;
+        while (remaining > 0 && !faulted()) {
+            const auto address = PC;
+            const auto block = jit->block_at(*this, address);
+            if (block.fn != nullptr) {
+                const auto executed = block.fn(&jit_state, remaining);
+                if (faulted()) [[unlikely]] {
+                    // only block terminators can fault, the faulting instruction is not counted, like in exec_op_cycle
+                    tick_count += static_cast<std::size_t>(executed - 1);
+                    jit_instructions += static_cast<std::size_t>(executed - 1);
+                    stop_on_fault(gsl::narrow_cast<uint16_t>(address + 2 * (executed - 1)));
+                    return;
+                }
+                tick_count += static_cast<std::size_t>(executed);
+                jit_instructions += static_cast<std::size_t>(executed);
+                remaining -= executed;
+            } else {
+                exec_op_cycle();
+                remaining--;
+            }
+        }
+    }
+
+
+    // Operations do not throw, faults are checked by run_jit after the block.
+    void Chip8::jit_fallback(Chip8 *chip8, uint16_t opcode) {
+        std::invoke(fetch_op(opcode), chip8, opcode);
     }
 
 
     std::array<uint8_t, Chip8::screen_size> Chip8::get_screen() const {
         std::array<uint8_t, Chip8::screen_size> screen{0};
-
-        // for_each byte of the display_buffer
-        // set 8 fields of the screen array
-        std::for_each(
-                display_buffer.rbegin(), display_buffer.rend(),
-
-                [&screen, idx = std::size_t{0}](uint8_t byte) mutable {
-                    std::bitset<8> bitIsSet{byte};
-                    for (std::size_t i = 0; i < 8; i++) {
-                        screen[idx] = bitIsSet[i] ? 0xFF : 0x0;
-                        idx++;
-                    }
-                });
+        get_screen(screen);
         return screen;
     }
 
 
+    void Chip8::get_screen(std::span<uint8_t, screen_size> screen) const {
+        // the texture is filled from the bottom row up, starting with the rightmost pixel
+        DisplayRows bottom_up{};
+        std::ranges::reverse_copy(display_rows, bottom_up.begin());
+        pixels::expand_rows(bottom_up, screen);
+    }
+
+
+    void Chip8::get_screen_rgba(std::span<uint8_t, 4 * screen_size> image, const pixels::Palette &palette) const {
+        pixels::expand_rows_rgba(display_rows, image, palette);
+    }
+
+
     // make sure PC never points to a location bigger than the memory
     void Chip8::incPC() {
         PC = gsl::narrow_cast<uint16_t>(std::min(PC + 2, mem_size - 2));
@@ -454,7 +766,7 @@ namespace chip8 {
         PC = pc_start_address;
         I = 0;
 
-        static constexpr std::array<uint8_t, bytes_in_screen> start_screen{
+        static constexpr auto start_screen = to_display_rows({
                 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
                 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
                 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
@@ -471,17 +783,21 @@ namespace chip8 {
                 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
                 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
                 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
-        };
-        ranges::copy(start_screen, display_buffer.begin());
+        });
+        display_rows = start_screen;
+        dirty_rows = all_rows_dirty;
 
         // clear registers
         ranges::fill(V, 0);
         // clear stack
-        stack = {};
+        stack_pointer = 0;
         delay_timer = 0;
         sound_timer = 0;
 
         tick_count = 0;
+        jit_instructions = 0;
+        fault = {};
+        random_generator.reseed(seed);
         call_stack.clear();
         draw_flag = true;
     }
@@ -507,26 +823,62 @@ namespace chip8 {
 
     void Chip8::set_shift_implementation(bool shift_vy) {
         shift_implementation_vy = shift_vy;
+        // compiled blocks have the shift implementation built in
+        if (jit) { jit->reset(); }
+    }
+
+
+    void Chip8::set_backend(Backend t_backend) {
+        backend = t_backend;
+        if (backend == Backend::Jit && !jit && Jit::supported()) { jit = std::make_unique<Jit>(); }
     }
 
 
     void Chip8::tick() {
+        tick(cycles_per_frame);
+    }
+
+
+    void Chip8::tick(int instructions) {
         if (state == State::Running) {
             signal();
-            try {
-                for (auto i = 0; i < cycles_per_frame; i++) {
-                    exec_op_cycle();
-                }
-            } catch (std::range_error &e) {
-                spdlog::error("Invalid opcode!\n {}", e.what());
-                error();
+            run_instructions(instructions);
+        }
+    }
+
+
+    void Chip8::run_instructions(int count) {
+        if (state != State::Running) { return; }
+        // programs waiting for a timer or a key usually start every frame in the idle loop
+        if (idle_skipping) {
+            if (const auto length = idle_loop_length(PC); length != 0) {
+                skip_idle_loop(length, count);
+                return;
             }
         }
+        if (backend == Backend::Threaded) {
+            run_threaded(count);
+        } else if (backend == Backend::Jit) {
+            run_jit(count);
+        } else if (backend == Backend::Aot) {
+            run_aot(count);
+        } else {
+            run_interpreter(count);
+        }
+    }
+
+
+    void Chip8::stop_on_fault(uint16_t address) {
+        fault.pc = address;
+        if (fault_logging) {
+            spdlog::error("Chip8 program stopped: {} at {:03X} ({:04X})", fault_name(fault.fault), fault.pc, fault.opcode);
+        }
+        error();
     }
 
     void Chip8::error() {
         state = State::Empty;
-        static constexpr std::array<uint8_t, bytes_in_screen> error_screen{
+        static constexpr auto error_screen = to_display_rows({
                 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
                 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
                 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
@@ -543,14 +895,185 @@ namespace chip8 {
                 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
                 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
                 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
-        };
-        ranges::copy(error_screen, display_buffer.begin());
+        });
+        display_rows = error_screen;
+        dirty_rows = all_rows_dirty;
         draw_flag = true;
         // display error
     }
 
-    const std::array<uint8_t, bytes_in_screen> &Chip8::get_display_buffer() const {
-        return display_buffer;
+    std::size_t Chip8::add_display_consumer() {
+        if (display_consumers == max_display_consumers) {
+            spdlog::warn("More than {} display consumers, the new one redraws every row", max_display_consumers);
+            return untracked_consumer;
+        }
+        distribute_dirty_rows();
+        consumer_dirty_rows[display_consumers] = all_rows_dirty;
+        return display_consumers++;
+    }
+
+
+    Chip8::DirtyRows Chip8::take_dirty_rows(std::size_t consumer) {
+        distribute_dirty_rows();
+        if (consumer >= display_consumers) { return all_rows_dirty; }
+        return std::exchange(consumer_dirty_rows[consumer], 0);
+    }
+
+
+    // The draw operations only mark rows in dirty_rows, they are handed out to the consumers
+    // when one of them asks.
+    void Chip8::distribute_dirty_rows() {
+        for (std::size_t idx = 0; idx < display_consumers; idx++) { consumer_dirty_rows[idx] |= dirty_rows; }
+        dirty_rows = 0;
+    }
+
+
+    uint64_t Chip8::state_hash() const {
+        auto hash = fnv1a_offset_basis;
+        // integers are hashed least significant byte first, independent of the host
+        const auto add = [&hash](uint64_t value, std::size_t bytes) {
+            for (std::size_t byte = 0; byte < bytes; byte++) {
+                const auto data = gsl::narrow_cast<uint8_t>(value >> (8 * byte));
+                hash = fnv1a(std::span(&data, 1), hash);
+            }
+        };
+        hash = fnv1a(V, hash);
+        add(PC, 2);
+        add(I, 2);
+        add(delay_timer, 1);
+        add(sound_timer, 1);
+        add(stack_pointer, 1);
+        for (std::size_t idx = 0; idx < stack_pointer; idx++) { add(stack[idx], 2); }
+        const auto random_state = random_generator.get_state();
+        add(random_state.state, 8);
+        add(random_state.increment, 8);
+        hash = fnv1a(memory, hash);
+        return fnv1a(get_display_buffer(), hash);
+    }
+
+
+    uint16_t Chip8::get_key_mask() const {
+        unsigned mask = 0;
+        for (std::size_t key = 0; key < keys.size(); key++) { mask |= static_cast<unsigned>(keys[key]) << key; }
+        return gsl::narrow_cast<uint16_t>(mask);
+    }
+
+
+    void Chip8::set_key_mask(uint16_t mask) {
+        for (std::size_t key = 0; key < keys.size(); key++) { keys[key] = ((mask >> key) & 1U) != 0; }
+    }
+
+
+    static_assert(std::is_trivially_copyable_v<Chip8::SaveState>);
+    // no padding, equal states have equal bytes
+    static_assert(std::has_unique_object_representations_v<Chip8::SaveState>);
+
+
+    Chip8::SaveState Chip8::save_state() const {
+        SaveState saved;
+        save_state(saved);
+        return saved;
+    }
+
+
+    void Chip8::save_state(SaveState &saved) const {
+        saved.magic = SaveState::magic_number;
+        saved.version = SaveState::current_version;
+        saved.seed = seed;
+        saved.random_state = random_generator.get_state();
+        saved.tick_count = tick_count;
+        saved.rom_hash = rom_hash;
+        saved.display_rows = display_rows;
+        saved.stack = stack;
+        saved.memory = memory;
+        saved.V = V;
+        saved.fault = fault;
+        saved.state = state;
+        saved.cycles_per_frame = cycles_per_frame;
+        saved.pc = PC;
+        saved.i = I;
+        saved.keys = get_key_mask();
+        saved.rom_size = gsl::narrow_cast<uint16_t>(program_size);
+        saved.stack_pointer = gsl::narrow_cast<uint8_t>(stack_pointer);
+        saved.stack_depth = gsl::narrow_cast<uint8_t>(stack_depth);
+        saved.delay_timer = delay_timer;
+        saved.sound_timer = sound_timer;
+        saved.shift_vy = static_cast<uint8_t>(shift_implementation_vy);
+        saved.reserved = {};
+    }
+
+
+    bool Chip8::load_state(const SaveState &saved) {
+        if (saved.magic != SaveState::magic_number || saved.version != SaveState::current_version) {
+            spdlog::error("Cannot load save state version {}, expected version {}", saved.version, SaveState::current_version);
+            return false;
+        }
+        // the block may come from a file: enums out of range are rejected, addresses are masked to
+        // memory below like every memory access; I can exceed it after FX1E and is masked wherever it is used
+        if (static_cast<unsigned>(saved.state) > static_cast<unsigned>(State::Empty) ||
+            static_cast<unsigned>(saved.fault.fault) > static_cast<unsigned>(Fault::StackUnderflow) ||
+            saved.cycles_per_frame < 0) {
+            spdlog::error("Cannot load an invalid save state");
+            return false;
+        }
+        // the predecoded, fused and recompiled code and movies belong to the loaded ROM
+        if (saved.rom_hash != rom_hash || saved.rom_size != program_size) {
+            spdlog::error("Cannot load a save state of another ROM");
+            return false;
+        }
+        // 0xFFF is a valid PC (1FFF), the opcode there wraps around to address 0
+        const auto mask_address = [](uint16_t address) { return static_cast<uint16_t>(address & address_mask); };
+
+        // only chunks that changed lose their decoded instructions and compiled blocks
+        static constexpr std::size_t chunk_size = 64;
+        for (std::size_t address = 0; address < mem_size; address += chunk_size) {
+            const auto *source = saved.memory.data() + address;
+            auto *target = memory.data() + address;
+            if (std::memcmp(source, target, chunk_size) != 0) {
+                std::memcpy(target, source, chunk_size);
+                invalidate_decoded(address, chunk_size);
+            }
+        }
+        for (std::size_t row = 0; row < display_rows.size(); row++) {
+            if (display_rows[row] != saved.display_rows[row]) { dirty_rows |= DirtyRows{1} << row; }
+        }
+        display_rows = saved.display_rows;
+
+        seed = saved.seed;
+        random_generator.set_state(saved.random_state);
+        tick_count = saved.tick_count;
+        std::ranges::transform(saved.stack, stack.begin(), mask_address);
+        V = saved.V;
+        fault = saved.fault;
+        state = saved.state;
+        cycles_per_frame = saved.cycles_per_frame;
+        PC = mask_address(saved.pc);
+        I = saved.i;
+        set_key_mask(saved.keys);
+        set_stack_depth(saved.stack_depth);
+        stack_pointer = std::min<std::size_t>(saved.stack_pointer, stack_depth);
+        delay_timer = saved.delay_timer;
+        sound_timer = saved.sound_timer;
+        if (shift_implementation_vy != (saved.shift_vy != 0)) { set_shift_implementation(saved.shift_vy != 0); }
+        call_stack.clear();
+        draw_flag = true;
+        return true;
+    }
+
+
+    bool Chip8::load_state(const SaveState &saved, const History &history) {
+        if (!load_state(saved)) { return false; }
+        call_stack = history;
+        return true;
+    }
+
+
+    std::array<uint8_t, bytes_in_screen> Chip8::get_display_buffer() const {
+        std::array<uint8_t, bytes_in_screen> bytes{};
+        for (std::size_t idx = 0; idx < bytes.size(); idx++) {
+            bytes[idx] = gsl::narrow_cast<uint8_t>(display_rows[idx / 8] >> (56U - 8U * (idx % 8)));
+        }
+        return bytes;
     }
 
 
@@ -0,0 +1,74 @@
+#include "chip8/EmulationClock.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <gsl/narrow>
+
+namespace chip8 {
+
+    static constexpr int64_t nanoseconds_per_second = std::chrono::nanoseconds(std::chrono::seconds(1)).count();
+
+    std::chrono::nanoseconds EmulationClock::steady_time() {
+        return std::chrono::steady_clock::now().time_since_epoch();
+    }
+
+
+    EmulationClock::EmulationClock(TimeSource t_time_source, int t_instructions_per_second)
+            : time_source(std::move(t_time_source)),
+              instructions_per_second(std::max(t_instructions_per_second, 0)),
+              origin(time_source()) {}
+
+
+    void EmulationClock::set_instructions_per_second(int t_instructions_per_second) {
+        instructions_per_second = std::max(t_instructions_per_second, 0);
+    }
+
+
+    std::chrono::nanoseconds EmulationClock::frame_time(int64_t frame) {
+        return std::chrono::nanoseconds(frame * nanoseconds_per_second / timer_frequency);
+    }
+
+
+    int EmulationClock::advance(Chip8 &chip8) {
+        return advance([&chip8](int instructions) { chip8.tick(instructions); });
+    }
+
+
+    int EmulationClock::advance(const std::function<void(int instructions)> &run_frame) {
+        const auto now = time_source();
+        const auto elapsed = (now - origin).count();
+        // the last frame with frame_time(frame) <= elapsed
+        const auto due = elapsed < 0 ? frames : (timer_frequency * (elapsed + 1) - 1) / nanoseconds_per_second;
+        auto to_run = std::max<int64_t>(due - frames, 0);
+        if (to_run > max_catch_up_frames) {
+            // drop the backlog, the next frame is due one frame period from now
+            to_run = max_catch_up_frames;
+            origin = now;
+            frames = 0;
+        } else {
+            frames += to_run;
+        }
+
+        for (int64_t frame = 0; frame < to_run; frame++) {
+            instruction_remainder += instructions_per_second;
+            const auto instructions = instruction_remainder / timer_frequency;
+            instruction_remainder %= timer_frequency;
+            run_frame(gsl::narrow_cast<int>(instructions));
+        }
+        return gsl::narrow_cast<int>(to_run);
+    }
+
+
+    std::chrono::nanoseconds EmulationClock::until_next_frame() const {
+        const auto left = origin + frame_time(frames + 1) - time_source();
+        return std::max(left, std::chrono::nanoseconds::zero());
+    }
+
+
+    void EmulationClock::restart() {
+        origin = time_source();
+        frames = 0;
+    }
+
+} // namespace chip8
@@ -0,0 +1,238 @@
+#include "chip8/EmulationThread.h"
+
+#include <fstream>
+#include <utility>
+
+#include <gsl/narrow>
+#include <spdlog/spdlog.h>
+
+namespace chip8 {
+
+    template<class... Ts>
+    struct overloaded : Ts... { using Ts::operator()...; };
+
+
+    EmulationThread::EmulationThread(Chip8 &t_chip8, EmulationClock t_clock)
+            : chip8(t_chip8),
+              clock(std::move(t_clock)),
+              display_consumer(chip8.add_display_consumer()),
+              frame_instructions(gsl::narrow_cast<int>(clock.get_instructions_per_second() / EmulationClock::timer_frequency)) {
+        // the first snapshot is available before the thread runs
+        publish();
+        snapshots.update();
+        thread = std::jthread([this](const std::stop_token &stop) { run(stop); });
+    }
+
+
+    EmulationThread::~EmulationThread() {
+        thread.request_stop();
+        thread.join();
+    }
+
+
+    bool EmulationThread::send(Command command) {
+        if (!commands.push(std::move(command))) {
+            spdlog::warn("Emulation command queue is full, command dropped");
+            return false;
+        }
+        return true;
+    }
+
+
+    void EmulationThread::set_key(std::size_t key, bool pressed) {
+        const auto bit = static_cast<uint16_t>(1U << key);
+        if (pressed) {
+            keys.fetch_or(bit, std::memory_order_relaxed);
+        } else {
+            keys.fetch_and(static_cast<uint16_t>(~bit), std::memory_order_relaxed);
+        }
+    }
+
+
+    void EmulationThread::run(const std::stop_token &stop) {
+        clock.restart();
+        while (!stop.stop_requested()) {
+            while (auto command = commands.pop()) { execute(*command); }
+            if (clock.advance([this](int instructions) { run_frame(instructions); }) > 0) { publish(); }
+            std::this_thread::sleep_for(clock.until_next_frame());
+        }
+        stop_recording();
+    }
+
+
+    void EmulationThread::run_frame(int instructions) {
+        frame_instructions = instructions;
+        if (rewinding) {
+            rewind.step_back(chip8);
+            return;
+        }
+        if (player && !player->finished()) {
+            // the movie decides the keys and the instructions of its frames
+            player->play_frame(chip8);
+        } else {
+            // the keys change at frame boundaries only, so a recording can reproduce them
+            const auto pressed = keys.load(std::memory_order_relaxed);
+            if (recorder) { recorder->record_frame(chip8, pressed, instructions); }
+            chip8.set_key_mask(pressed);
+            chip8.tick(instructions);
+        }
+        if (chip8.get_state() == State::Running) { rewind.capture(chip8); }
+    }
+
+
+    void EmulationThread::execute(const Command &command) {
+        std::visit(overloaded{
+                [this](const command::TogglePause &) { chip8.toggle_pause(); },
+                [this](const command::ResetRom &) {
+                    stop_recording();
+                    player.reset();
+                    chip8.reset_rom();
+                    rewind.clear();
+                },
+                [this](const command::LoadRom &load) {
+                    stop_recording();
+                    player.reset();
+                    chip8.load_rom_from_file(load.path);
+                    rom_path = load.path;
+                    rewind.clear();
+                },
+                [this](const command::ExecuteInstruction &) {
+                    const auto state = chip8.get_state();
+                    if (state == State::Paused && player && !player->finished()) {
+                        seek(chip8.get_tick_count() + 1);
+                    } else if (state == State::Paused || state == State::Reset) {
+                        stop_recording();
+                        chip8.set_key_mask(keys.load(std::memory_order_relaxed));
+                        chip8.exec_op_cycle();
+                    }
+                },
+                [this](const command::SetShiftImplementation &shift) {
+                    if (shift.shift_vy != chip8.get_shift_implementation()) {
+                        stop_recording();
+                        player.reset();
+                    }
+                    chip8.set_shift_implementation(shift.shift_vy);
+                },
+                [this](const command::SetBackend &set) { chip8.set_backend(set.backend); },
+                [this](const command::SetInstructionsPerSecond &set) { clock.set_instructions_per_second(set.instructions); },
+                [this](const command::SetRewinding &set) {
+                    if (set.active) {
+                        stop_recording();
+                        player.reset();
+                    }
+                    rewinding = set.active;
+                },
+                [this](const command::StartRecording &start) { start_recording(start.path); },
+                [this](const command::StopRecording &) { stop_recording(); },
+                [this](const command::PlayMovie &play) { play_movie(play.path); },
+                [this](const command::StopMovie &) { player.reset(); },
+                [this](const command::SetRunAhead &set) { run_ahead.set_frames(set.frames); },
+                [this](const command::SeekTick &seek_tick) {
+                    if (!player) {
+                        spdlog::error("Play a movie before seeking");
+                        return;
+                    }
+                    seek(seek_tick.tick);
+                    // the history before the seek belongs to another point of the movie
+                    rewind.clear();
+                },
+        }, command);
+    }
+
+
+    void EmulationThread::start_recording(const std::string &path) {
+        stop_recording();
+        player.reset();
+        if (rom_path.empty()) {
+            spdlog::error("Load a ROM before recording a movie");
+            return;
+        }
+        // a movie starts with the freshly loaded ROM
+        chip8.load_rom_from_file(rom_path);
+        chip8.toggle_pause();
+        rewind.clear();
+        recorder.emplace(chip8);
+        movie_path = path;
+        spdlog::info("Recording movie {}", movie_path);
+    }
+
+
+    void EmulationThread::stop_recording() {
+        if (!recorder) { return; }
+        std::ofstream file(movie_path, std::ios::binary);
+        if (!recorder->finish(chip8).write(file)) {
+            spdlog::error("Could not write movie {}", movie_path);
+        } else {
+            spdlog::info("Movie written to {}", movie_path);
+        }
+        recorder.reset();
+    }
+
+
+    void EmulationThread::play_movie(const std::string &path) {
+        stop_recording();
+        player.reset();
+        if (rom_path.empty()) {
+            spdlog::error("Load the ROM of the movie before playing it");
+            return;
+        }
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            spdlog::error("Could not open movie {}", path);
+            return;
+        }
+        auto movie = Movie::read(file);
+        if (!movie) { return; }
+
+        chip8.load_rom_from_file(rom_path);
+        rewind.clear();
+        player.emplace(std::move(*movie));
+        if (!player->start(chip8)) {
+            player.reset();
+            return;
+        }
+        spdlog::info("Playing movie {}", path);
+    }
+
+
+    void EmulationThread::seek(std::size_t tick) {
+        const auto paused = chip8.get_state() == State::Paused;
+        if (paused) { chip8.toggle_pause(); }
+        if (!player->seek(chip8, tick)) { spdlog::warn("The movie ends before tick {}", tick); }
+        if (paused && chip8.get_state() == State::Running) { chip8.toggle_pause(); }
+    }
+
+
+    void EmulationThread::publish() {
+        auto &snapshot = snapshots.write_buffer();
+        snapshot.frame = frame++;
+        snapshot.state = chip8.get_state();
+        snapshot.display_rows = chip8.get_display_rows();
+        snapshot.dirty_rows = chip8.take_dirty_rows(display_consumer);
+        snapshot.memory = chip8.get_memory();
+        snapshot.registers = chip8.get_registers();
+        snapshot.history = chip8.get_call_stack();
+        snapshot.pc = chip8.get_pc();
+        snapshot.i = chip8.get_i();
+        snapshot.delay_timer = chip8.get_delay_timer();
+        snapshot.sound_timer = chip8.get_sound_timer();
+        snapshot.stack_pointer = chip8.get_stack_pointer();
+        snapshot.tick_count = chip8.get_tick_count();
+        snapshot.fault = chip8.get_fault();
+        snapshot.sound = chip8.sound_signal();
+        snapshot.instructions_per_second = clock.get_instructions_per_second();
+        snapshot.backend = chip8.get_backend();
+        snapshot.rewinding = rewinding;
+        snapshot.rewind = rewind.get_stats();
+        snapshot.recording = recorder.has_value();
+        snapshot.movie_loaded = player.has_value();
+        snapshot.movie_end_tick = player ? player->get_movie().end_tick : 0;
+        const auto live_keys = !rewinding && (!player || player->finished());
+        snapshot.run_ahead_frames = live_keys && run_ahead.run(chip8, frame_instructions, display_consumer,
+                                                               snapshot.display_rows, snapshot.dirty_rows)
+                                            ? run_ahead.get_frames() : 0;
+        snapshot.run_ahead_nanoseconds = run_ahead.get_nanoseconds();
+        snapshots.publish();
+    }
+
+} // namespace chip8
@@ -0,0 +1,370 @@
+#include "chip8/Jit.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include <gsl/narrow>
+#include <spdlog/spdlog.h>
+
+#include "chip8/BasicBlock.h"
+#include "chip8/Chip8.h"
+#include "chip8/InstructionPartAccessorFunctions.h"
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__))
+#define CHIP8_JIT_X86_64
+#include <sys/mman.h>
+#endif
+
+namespace chip8 {
+
+    static_assert(Chip8::mem_size == 4096);
+
+    namespace {
+        // Emits x86-64 machine code. Register usage inside a block:
+        // rbx = V, r12 = &I, r13 = &PC, r14 = &delay_timer, r15 = &sound_timer, rbp = Chip8*
+        class Emitter {
+          public:
+            std::vector<uint8_t> code;
+
+            void bytes(std::initializer_list<uint8_t> values) {
+                code.insert(code.end(), values);
+            }
+
+            void imm16(uint16_t value) {
+                bytes({gsl::narrow_cast<uint8_t>(value & 0xFFU), gsl::narrow_cast<uint8_t>(value >> 8U)});
+            }
+
+            void imm32(uint32_t value) {
+                for (int shift = 0; shift < 32; shift += 8) { code.push_back(gsl::narrow_cast<uint8_t>(value >> shift)); }
+            }
+
+            void imm64(uint64_t value) {
+                for (int shift = 0; shift < 64; shift += 8) { code.push_back(gsl::narrow_cast<uint8_t>(value >> shift)); }
+            }
+
+            void prologue() {
+                bytes({0x55, 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57}); // push rbp, rbx, r12-r15
+                bytes({0x48, 0x83, 0xEC, 0x08});        // sub rsp, 8 (align the stack for calls)
+                bytes({0x89, 0x34, 0x24});              // mov [rsp], esi (the instruction budget)
+                bytes({0x48, 0x8B, 0x1F});              // mov rbx, [rdi]
+                bytes({0x4C, 0x8B, 0x67, 0x08});        // mov r12, [rdi + 8]
+                bytes({0x4C, 0x8B, 0x6F, 0x10});        // mov r13, [rdi + 16]
+                bytes({0x4C, 0x8B, 0x77, 0x18});        // mov r14, [rdi + 24]
+                bytes({0x4C, 0x8B, 0x7F, 0x20});        // mov r15, [rdi + 32]
+                bytes({0x48, 0x8B, 0x6F, 0x28});        // mov rbp, [rdi + 40]
+            }
+
+            // return the number of executed instructions
+            void epilogue(uint16_t executed) {
+                bytes({0xB8});                          // mov eax, imm32
+                imm32(executed);
+                bytes({0x48, 0x83, 0xC4, 0x08});        // add rsp, 8
+                bytes({0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0x5D}); // pop r15-r12, rbx, rbp
+                bytes({0xC3});                          // ret
+            }
+
+            void set_pc(uint16_t pc) {
+                bytes({0x66, 0x41, 0xC7, 0x45, 0x00}); // mov word [r13], imm16
+                imm16(pc);
+            }
+
+            void load_v(uint16_t reg) { bytes({0x8A, 0x43, gsl::narrow_cast<uint8_t>(reg)}); }    // mov al, [rbx + reg]
+            void store_v(uint16_t reg) { bytes({0x88, 0x43, gsl::narrow_cast<uint8_t>(reg)}); }   // mov [rbx + reg], al
+            void movzx_v(uint16_t reg) { bytes({0x0F, 0xB6, 0x43, gsl::narrow_cast<uint8_t>(reg)}); } // movzx eax, byte [rbx + reg]
+            void store_vf_cl() { bytes({0x88, 0x4B, 0x0F}); }                                      // mov [rbx + 15], cl
+
+            // jle to a label that is not emitted yet, returns the position of the displacement;
+            // executed is compared as signed 8 bit immediate
+            std::size_t jump_if_budget_used(uint16_t executed) {
+                bytes({0x83, 0x3C, 0x24, gsl::narrow_cast<uint8_t>(executed)}); // cmp dword [rsp], imm8
+                bytes({0x0F, 0x8E});                                              // jle rel32
+                imm32(0);
+                return code.size() - 4;
+            }
+
+            void patch_jump(std::size_t displacement) {
+                const auto offset = gsl::narrow_cast<uint32_t>(code.size() - (displacement + 4));
+                for (std::size_t byte = 0; byte < 4; byte++) {
+                    code[displacement + byte] = gsl::narrow_cast<uint8_t>(offset >> (8 * byte));
+                }
+            }
+
+            void call(uint64_t function, uint16_t opcode) {
+                bytes({0x48, 0x89, 0xEF});              // mov rdi, rbp
+                bytes({0xBE});                          // mov esi, imm32
+                imm32(opcode);
+                bytes({0x48, 0xB8});                    // mov rax, imm64
+                imm64(function);
+                bytes({0xFF, 0xD0});                    // call rax
+            }
+        };
+
+        constexpr std::size_t page_of(std::size_t address, std::size_t page_size) {
+            return address / page_size;
+        }
+    }
+
+
+    Jit::Jit() {
+#ifdef CHIP8_JIT_X86_64
+        void *memory = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory != MAP_FAILED) { buffer = static_cast<uint8_t *>(memory); }
+#endif
+    }
+
+
+    Jit::~Jit() {
+#ifdef CHIP8_JIT_X86_64
+        if (buffer != nullptr) { munmap(buffer, capacity); }
+#endif
+    }
+
+
+    Jit::Jit(Jit &&other) noexcept
+            : buffer(std::exchange(other.buffer, nullptr)), used(other.used), flush_pending(other.flush_pending),
+              blocks(other.blocks), code_pages(other.code_pages) {
+        other.flush();
+    }
+
+
+    Jit &Jit::operator=(Jit &&other) noexcept {
+        if (this != &other) {
+            std::swap(buffer, other.buffer);
+            used = other.used;
+            flush_pending = other.flush_pending;
+            blocks = other.blocks;
+            code_pages = other.code_pages;
+            other.flush();
+        }
+        return *this;
+    }
+
+
+    bool Jit::supported() {
+#ifdef CHIP8_JIT_X86_64
+        return true;
+#else
+        return false;
+#endif
+    }
+
+
+    Jit::Block Jit::block_at(const Chip8 &chip8, uint16_t address) {
+        if (flush_pending) { flush(); }
+        auto &block = blocks[address];
+        if (!block.compiled) { block = compile(chip8, address); }
+        return block;
+    }
+
+
+    void Jit::invalidate(std::size_t address, std::size_t length) {
+        const auto last = std::min(address + length, mem_size);
+        for (auto page = page_of(address, page_size); page < mem_size / page_size && page * page_size < last; page++) {
+            if (code_pages[page]) {
+                // a block calling into the Chip8 may still be running, flush on the next lookup
+                flush_pending = true;
+                return;
+            }
+        }
+    }
+
+
+    void Jit::flush() {
+        used = 0;
+        blocks.fill({});
+        code_pages.fill(false);
+        flush_pending = false;
+    }
+
+
+    void Jit::disable() {
+#ifdef CHIP8_JIT_X86_64
+        spdlog::warn("Cannot make compiled code executable, the jit backend interprets from now on");
+        munmap(buffer, capacity);
+        buffer = nullptr;
+#endif
+        flush();
+    }
+
+
+    Jit::Block Jit::compile(const Chip8 &chip8, uint16_t address) {
+        if (buffer == nullptr) { return {nullptr, 0, true}; }
+
+        static constexpr auto F = uint16_t{0xF};
+        const auto callback = reinterpret_cast<uint64_t>(&Chip8::jit_fallback); // NOLINT function address as immediate
+
+        Emitter emit;
+        emit.prologue();
+
+        // the block is left before an instruction once the budget is used up, PC points to it then
+        struct Exit {
+            std::size_t displacement = 0;
+            uint16_t executed = 0;
+            uint16_t pc = 0;
+        };
+        std::vector<Exit> exits;
+        static_assert(max_block_length <= 127);
+
+        uint16_t length = 0;
+        auto pc = address;
+        bool terminated = false;
+        // stop before the last instruction of memory, where incPC saturates
+        while (!terminated && length < max_block_length && pc + 4U <= mem_size) {
+            const auto opcode = gsl::narrow_cast<uint16_t>((chip8.memory[pc] << 8U) | chip8.memory[pc + 1U]);
+            const auto idx = Chip8::op_index_table[opcode];
+            if (idx == Chip8::num_opcodes) { break; } // leave invalid opcodes to the interpreter
+            // the caller's budget is at least one instruction
+            if (length != 0) { exits.push_back({emit.jump_if_budget_used(length), length, pc}); }
+            const auto next = gsl::narrow_cast<uint16_t>(pc + 2);
+            const auto x = X(opcode);
+            const auto y = Y(opcode);
+            const auto shift_source = chip8.shift_implementation_vy ? y : x;
+
+            switch (Chip8::operations[idx].first) {
+                case 0x1000:
+                    emit.set_pc(nnn(opcode));
+                    terminated = true;
+                    break;
+                case 0x6000:
+                    emit.bytes({0xC6, 0x43, gsl::narrow_cast<uint8_t>(x), nn(opcode)}); // mov byte [rbx + x], nn
+                    break;
+                case 0x7000:
+                    emit.bytes({0x80, 0x43, gsl::narrow_cast<uint8_t>(x), nn(opcode)}); // add byte [rbx + x], nn
+                    break;
+                case 0x8000:
+                    emit.load_v(y);
+                    emit.store_v(x);
+                    break;
+                case 0x8001:
+                    emit.load_v(y);
+                    emit.bytes({0x08, 0x43, gsl::narrow_cast<uint8_t>(x)}); // or [rbx + x], al
+                    break;
+                case 0x8002:
+                    emit.load_v(y);
+                    emit.bytes({0x20, 0x43, gsl::narrow_cast<uint8_t>(x)}); // and [rbx + x], al
+                    break;
+                case 0x8003:
+                    emit.load_v(y);
+                    emit.bytes({0x30, 0x43, gsl::narrow_cast<uint8_t>(x)}); // xor [rbx + x], al
+                    break;
+                case 0x8004:
+                    emit.load_v(x);
+                    emit.bytes({0x02, 0x43, gsl::narrow_cast<uint8_t>(y)}); // add al, [rbx + y]
+                    emit.bytes({0x0F, 0x92, 0xC1});                          // setc cl
+                    emit.store_v(x);
+                    emit.store_vf_cl();
+                    break;
+                case 0x8005:
+                    emit.load_v(x);
+                    emit.bytes({0x2A, 0x43, gsl::narrow_cast<uint8_t>(y)}); // sub al, [rbx + y]
+                    emit.bytes({0x0F, 0x93, 0xC1});                          // setnc cl
+                    emit.store_v(x);
+                    emit.store_vf_cl();
+                    break;
+                case 0x8007:
+                    emit.load_v(y);
+                    emit.bytes({0x2A, 0x43, gsl::narrow_cast<uint8_t>(x)}); // sub al, [rbx + x]
+                    emit.bytes({0x0F, 0x93, 0xC1});                          // setnc cl
+                    emit.store_v(x);
+                    emit.store_vf_cl();
+                    break;
+                case 0x8006:
+                    // VF is written first and the source is read again, as in op_rshift
+                    emit.load_v(shift_source);
+                    emit.bytes({0x88, 0xC1, 0x80, 0xE1, 0x01}); // mov cl, al; and cl, 1
+                    emit.store_vf_cl();
+                    emit.load_v(shift_source);
+                    emit.bytes({0xD0, 0xE8});                   // shr al, 1
+                    emit.store_v(x);
+                    break;
+                case 0x800E:
+                    emit.load_v(shift_source);
+                    emit.bytes({0xC0, 0xE8, 0x07});             // shr al, 7
+                    emit.store_v(F);
+                    emit.load_v(shift_source);
+                    emit.bytes({0xD0, 0xE0});                   // shl al, 1
+                    emit.store_v(x);
+                    break;
+                case 0xA000:
+                    emit.bytes({0x66, 0x41, 0xC7, 0x04, 0x24}); // mov word [r12], imm16
+                    emit.imm16(nnn(opcode));
+                    break;
+                case 0xF007:
+                    emit.bytes({0x41, 0x8A, 0x06});             // mov al, [r14]
+                    emit.store_v(x);
+                    break;
+                case 0xF015:
+                    emit.load_v(x);
+                    emit.bytes({0x41, 0x88, 0x06});             // mov [r14], al
+                    break;
+                case 0xF018:
+                    emit.load_v(x);
+                    emit.bytes({0x41, 0x88, 0x07});             // mov [r15], al
+                    break;
+                case 0xF01E:
+                    emit.movzx_v(x);
+                    emit.bytes({0x66, 0x41, 0x01, 0x04, 0x24}); // add [r12], ax
+                    break;
+                case 0xF029:
+                    emit.movzx_v(x);
+                    emit.bytes({0x83, 0xE0, 0x0F});             // and eax, 0xF
+                    emit.bytes({0x8D, 0x04, 0x80});             // lea eax, [rax + rax * 4]
+                    emit.bytes({0x66, 0x41, 0x89, 0x04, 0x24}); // mov [r12], ax
+                    break;
+                default:
+                    // PC has to be up to date for calls, returns and skips
+                    emit.set_pc(next);
+                    emit.call(callback, opcode);
+                    terminated = ends_basic_block(opcode);
+                    break;
+            }
+            length++;
+            pc = next;
+        }
+
+        if (length == 0) { return {nullptr, 0, true}; }
+        if (!terminated) { emit.set_pc(pc); }
+        emit.epilogue(length);
+        for (const auto &exit: exits) {
+            emit.patch_jump(exit.displacement);
+            emit.set_pc(exit.pc);
+            emit.epilogue(exit.executed);
+        }
+
+        const auto fn = install(emit.code);
+        if (fn == nullptr) { return {nullptr, 0, false}; }
+        for (auto page = page_of(address, page_size); page <= page_of(pc - 1U, page_size); page++) {
+            code_pages[page] = true;
+        }
+        return {fn, length, true};
+    }
+
+
+    Jit::BlockFn Jit::install(const std::vector<uint8_t> &code) {
+#ifdef CHIP8_JIT_X86_64
+        if (used + code.size() > capacity) {
+            // lookups happen between blocks, no compiled code is running
+            flush();
+            if (code.size() > capacity) { return nullptr; }
+        }
+        // the buffer is never writable and executable at once, the system may refuse to switch
+        if (mprotect(buffer, capacity, PROT_READ | PROT_WRITE) != 0) {
+            disable();
+            return nullptr;
+        }
+        std::memcpy(buffer + used, code.data(), code.size());
+        if (mprotect(buffer, capacity, PROT_READ | PROT_EXEC) != 0) {
+            disable();
+            return nullptr;
+        }
+        auto *const start = buffer + used;
+        used += code.size();
+        return reinterpret_cast<BlockFn>(start); // NOLINT machine code to function pointer
+#else
+        static_cast<void>(code);
+        return nullptr;
+#endif
+    }
+
+} // namespace chip8
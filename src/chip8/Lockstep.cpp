@@ -0,0 +1,452 @@
+#include "chip8/Lockstep.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <memory>
+
+#include <gsl/narrow>
+
+#include "chip8/InstructionPartAccessorFunctions.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define CHIP8_LOCKSTEP_X86_64
+#include <immintrin.h>
+#endif
+
+namespace chip8 {
+
+    static constexpr auto address_mask = Chip8::address_mask;
+    static constexpr auto last_pc = uint16_t{Chip8::mem_size - 2};
+    static constexpr auto sprite_size = 5;
+    static constexpr std::size_t VF = 0xF;
+
+    // PC after an instruction at address, saturating like Chip8::incPC
+    static constexpr uint16_t next_pc(uint16_t address) {
+        return gsl::narrow_cast<uint16_t>(std::min(address + 2, int{last_pc}));
+    }
+
+
+    Lockstep::Lockstep(std::span<const uint8_t> rom, std::span<const uint64_t> seeds, const Config &t_config)
+            : config(t_config),
+              lanes(seeds.size()),
+              stride((seeds.size() + lane_block - 1) / lane_block * lane_block),
+              registers(Chip8::num_registers * stride),
+              pc(stride, Chip8::pc_start_address),
+              index(stride),
+              delay_timer(stride),
+              sound_timer(stride),
+              stack_pointer(stride),
+              stack(Chip8::max_stack_depth * stride),
+              keys(stride),
+              running(stride),
+              group(stride),
+              tick_count(stride),
+              faults(stride),
+              random_generators(stride),
+              display_rows(Chip8::screen_height * stride),
+              own_memory(Chip8::mem_size * stride),
+              wrote_memory(stride) {
+        config.stack_depth = std::clamp<std::size_t>(config.stack_depth, 1, Chip8::max_stack_depth);
+#ifdef CHIP8_LOCKSTEP_X86_64
+        simd = config.use_simd && __builtin_cpu_supports("avx2");
+#else
+        simd = false;
+#endif
+        // the memory of a Chip8 that loaded the ROM: font and program
+        const auto chip8 = std::make_unique<Chip8>();
+        chip8->load_rom(rom);
+        image = chip8->get_memory();
+
+        std::fill(running.begin(), running.begin() + static_cast<std::ptrdiff_t>(lanes), uint8_t{0xFF});
+        for (std::size_t lane = 0; lane < lanes; lane++) { random_generators[lane].reseed(seeds[lane]); }
+    }
+
+
+    std::array<uint8_t, Chip8::num_registers> Lockstep::get_registers(std::size_t lane) const {
+        std::array<uint8_t, Chip8::num_registers> values{};
+        for (std::size_t x = 0; x < values.size(); x++) { values[x] = registers[x * stride + lane]; }
+        return values;
+    }
+
+
+    std::span<const uint8_t, Chip8::mem_size> Lockstep::get_memory(std::size_t lane) const {
+        return std::span<const uint8_t, Chip8::mem_size>(memory_of(lane), Chip8::mem_size);
+    }
+
+
+    std::span<const uint64_t, Chip8::screen_height> Lockstep::get_display_rows(std::size_t lane) const {
+        return std::span<const uint64_t, Chip8::screen_height>(&display_rows[lane * Chip8::screen_height], Chip8::screen_height);
+    }
+
+
+    const uint8_t *Lockstep::memory_of(std::size_t lane) const {
+        return wrote_memory[lane] != 0 ? &own_memory[lane * Chip8::mem_size] : image.data();
+    }
+
+
+    uint8_t *Lockstep::writable_memory(std::size_t lane) {
+        auto *memory = &own_memory[lane * Chip8::mem_size];
+        if (wrote_memory[lane] == 0) {
+            std::memcpy(memory, image.data(), image.size());
+            wrote_memory[lane] = 1;
+        }
+        return memory;
+    }
+
+
+    uint16_t Lockstep::fetch(std::size_t lane) const {
+        const auto *memory = memory_of(lane);
+        const auto address = pc[lane];
+        return gsl::narrow_cast<uint16_t>((memory[address & address_mask] << 8) | memory[(address + 1) & address_mask]);
+    }
+
+
+    void Lockstep::tick() {
+        for (std::size_t lane = 0; lane < lanes; lane++) {
+            if (running[lane] == 0) { continue; }
+            delay_timer[lane] = gsl::narrow_cast<uint8_t>(std::max(delay_timer[lane] - 1, 0));
+            sound_timer[lane] = gsl::narrow_cast<uint8_t>(std::max(sound_timer[lane] - 1, 0));
+        }
+        run_instructions(config.cycles_per_frame);
+    }
+
+
+    void Lockstep::run_instructions(int count) {
+        for (int instruction = 0; instruction < count; instruction++) { step(); }
+    }
+
+
+    void Lockstep::step() {
+        uint16_t group_pc = 0;
+        uint16_t opcode = 0;
+        const auto grouped = simd && find_group(group_pc, opcode) && exec_group_avx2(group_pc, opcode);
+        for (std::size_t lane = 0; lane < lanes; lane++) {
+            if (grouped && group[lane] != 0) {
+                tick_count[lane]++;
+                stats.simd_instructions++;
+            } else if (running[lane] != 0) {
+                exec_scalar(lane);
+                stats.scalar_instructions++;
+            }
+        }
+    }
+
+
+    // Same semantics as the operations of Chip8, see there.
+    void Lockstep::exec_scalar(std::size_t lane) {
+        const auto address = pc[lane];
+        const auto opcode = fetch(lane);
+        pc[lane] = next_pc(address);
+        const auto x = X(opcode);
+        const auto y = Y(opcode);
+        auto &vx = reg(x, lane);
+        auto &vy = reg(y, lane);
+        auto &vf = reg(VF, lane);
+        auto &sp = stack_pointer[lane];
+        auto &i = index[lane];
+        auto *rows = &display_rows[lane * Chip8::screen_height];
+        auto fault = Fault::None;
+
+        switch (get4Bit(opcode, 12)) {
+            case 0x0:
+                if (opcode == 0x00E0) {
+                    std::fill_n(rows, Chip8::screen_height, uint64_t{0});
+                } else if (opcode == 0x00EE) {
+                    if (sp == 0) {
+                        fault = Fault::StackUnderflow;
+                    } else {
+                        pc[lane] = stack[lane * Chip8::max_stack_depth + --sp];
+                    }
+                } else {
+                    fault = Fault::InvalidOpcode;
+                }
+                break;
+            case 0x1: pc[lane] = nnn(opcode); break;
+            case 0x2:
+                if (sp == config.stack_depth) {
+                    fault = Fault::StackOverflow;
+                } else {
+                    stack[lane * Chip8::max_stack_depth + sp++] = pc[lane];
+                    pc[lane] = nnn(opcode);
+                }
+                break;
+            case 0x3: if (vx == nn(opcode)) { pc[lane] = next_pc(pc[lane]); } break;
+            case 0x4: if (vx != nn(opcode)) { pc[lane] = next_pc(pc[lane]); } break;
+            case 0x5: if (vx == vy) { pc[lane] = next_pc(pc[lane]); } break;
+            case 0x6: vx = nn(opcode); break;
+            case 0x7: vx = gsl::narrow_cast<uint8_t>(vx + nn(opcode)); break;
+            case 0x8: {
+                const auto a = vx;
+                const auto b = vy;
+                // read again after writing VF, which may be the source
+                const auto &source = config.shift_vy ? vy : vx;
+                switch (n(opcode)) {
+                    case 0x0: vx = b; break;
+                    case 0x1: vx = a | b; break;
+                    case 0x2: vx = a & b; break;
+                    case 0x3: vx = a ^ b; break;
+                    case 0x4: vx = gsl::narrow_cast<uint8_t>(a + b); vf = a > vx; break; // NOLINT implicit bool conversion
+                    case 0x5: vx = gsl::narrow_cast<uint8_t>(a - b); vf = a >= vx; break; // NOLINT implicit bool conversion
+                    case 0x6: vf = source & 0x1U; vx = source >> 1U; break;
+                    case 0x7: vx = gsl::narrow_cast<uint8_t>(b - a); vf = b >= vx; break; // NOLINT implicit bool conversion
+                    case 0xE: vf = source >> 7U; vx = gsl::narrow_cast<uint8_t>(source << 1U); break;
+                    default: fault = Fault::InvalidOpcode; break;
+                }
+                break;
+            }
+            case 0x9: if (vx != vy) { pc[lane] = next_pc(pc[lane]); } break;
+            case 0xA: i = nnn(opcode); break;
+            case 0xB: pc[lane] = (nnn(opcode) + reg(0, lane)) & address_mask; break;
+            case 0xC: vx = gsl::narrow_cast<uint8_t>(random_generators[lane].next() >> 24U) & nn(opcode); break;
+            case 0xD: {
+                const auto *memory = memory_of(lane);
+                const auto column = vx % Chip8::screen_width;
+                const auto row = static_cast<unsigned>(vy % Chip8::screen_height);
+                uint64_t collisions = 0;
+                for (unsigned line = 0; line < n(opcode); line++) {
+                    const auto sprite_line = std::rotr(uint64_t{memory[(i + line) & address_mask]} << 56U, column);
+                    auto &display_row = rows[(row + line) % Chip8::screen_height];
+                    collisions |= display_row & sprite_line;
+                    display_row ^= sprite_line;
+                }
+                vf = static_cast<uint8_t>(collisions != 0);
+                break;
+            }
+            case 0xE: {
+                const auto pressed = ((keys[lane] >> (vx & 0xFU)) & 1U) != 0;
+                if (nn(opcode) == 0x9E) {
+                    if (pressed) { pc[lane] = next_pc(pc[lane]); }
+                } else if (nn(opcode) == 0xA1) {
+                    if (!pressed) { pc[lane] = next_pc(pc[lane]); }
+                } else {
+                    fault = Fault::InvalidOpcode;
+                }
+                break;
+            }
+            case 0xF:
+                switch (nn(opcode)) {
+                    case 0x07: vx = delay_timer[lane]; break;
+                    case 0x0A:
+                        if (keys[lane] != 0) {
+                            const auto key = std::countr_zero(keys[lane]);
+                            vx = gsl::narrow_cast<uint8_t>(key);
+                            keys[lane] = gsl::narrow_cast<uint16_t>(keys[lane] & ~(1U << key));
+                        } else {
+                            pc[lane] = gsl::narrow_cast<uint16_t>(pc[lane] - 2);
+                        }
+                        break;
+                    case 0x15: delay_timer[lane] = vx; break;
+                    case 0x18: sound_timer[lane] = vx; break;
+                    case 0x1E: i = gsl::narrow_cast<uint16_t>(i + vx); break;
+                    case 0x29: i = gsl::narrow_cast<uint16_t>(sprite_size * (vx & 0xFU)); break;
+                    case 0x33: {
+                        auto *memory = writable_memory(lane);
+                        const auto value = vx;
+                        memory[i & address_mask] = value / 100;
+                        memory[(i + 1) & address_mask] = (value % 100) / 10;
+                        memory[(i + 2) & address_mask] = value % 10;
+                        break;
+                    }
+                    case 0x55: {
+                        auto *memory = writable_memory(lane);
+                        for (std::size_t k = 0; k <= x; k++) { memory[(i + k) & address_mask] = reg(k, lane); }
+                        i = gsl::narrow_cast<uint16_t>(i + x + 1);
+                        break;
+                    }
+                    case 0x65: {
+                        const auto *memory = memory_of(lane);
+                        for (std::size_t k = 0; k <= x; k++) { reg(k, lane) = memory[(i + k) & address_mask]; }
+                        i = gsl::narrow_cast<uint16_t>(i + x + 1);
+                        break;
+                    }
+                    default: fault = Fault::InvalidOpcode; break;
+                }
+                break;
+            default: break;
+        }
+
+        if (fault != Fault::None) [[unlikely]] {
+            faults[lane] = {fault, address, opcode};
+            running[lane] = 0;
+            return;
+        }
+        tick_count[lane]++;
+    }
+
+
+#ifdef CHIP8_LOCKSTEP_X86_64
+
+    bool Lockstep::find_group(uint16_t &group_pc, uint16_t &opcode) {
+        const auto leader = static_cast<std::size_t>(std::ranges::find(running, uint8_t{0xFF}) - running.begin());
+        if (leader >= lanes) { return false; }
+        group_pc = pc[leader];
+        opcode = fetch(leader);
+        for (std::size_t lane = 0; lane < stride; lane++) {
+            group[lane] = static_cast<uint8_t>(running[lane] & (pc[lane] == group_pc ? 0xFFU : 0U));
+        }
+        // lanes with their own memory may have a different instruction at the same address
+        const auto image_matches = gsl::narrow_cast<uint16_t>((image[group_pc] << 8) | image[(group_pc + 1) & address_mask]) == opcode;
+        for (std::size_t lane = 0; lane < lanes; lane++) {
+            if (group[lane] == 0) { continue; }
+            if (wrote_memory[lane] != 0 ? fetch(lane) != opcode : !image_matches) { group[lane] = 0; }
+        }
+        return true;
+    }
+
+
+    namespace {
+        using Bytes = __m256i;
+
+        __attribute__((target("avx2"))) Bytes load(const uint8_t *bytes) {
+            return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes)); // NOLINT intrinsic load
+        }
+
+        __attribute__((target("avx2"))) void store(uint8_t *bytes, Bytes value) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(bytes), value); // NOLINT intrinsic store
+        }
+
+        // write value to the lanes selected by mask
+        __attribute__((target("avx2"))) void store_lanes(uint8_t *bytes, Bytes value, Bytes mask) {
+            store(bytes, _mm256_blendv_epi8(load(bytes), value, mask));
+        }
+
+        // write 32 16 bit values, low for the first 16 lanes and high for the others, to the lanes selected by mask
+        __attribute__((target("avx2"))) void store_lanes(uint16_t *words, Bytes low, Bytes high, Bytes mask) {
+            auto *first = reinterpret_cast<__m256i *>(words);      // NOLINT intrinsic load/store
+            auto *second = reinterpret_cast<__m256i *>(words + 16); // NOLINT intrinsic load/store
+            const auto low_mask = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(mask));
+            const auto high_mask = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(mask, 1));
+            _mm256_storeu_si256(first, _mm256_blendv_epi8(_mm256_loadu_si256(first), low, low_mask));
+            _mm256_storeu_si256(second, _mm256_blendv_epi8(_mm256_loadu_si256(second), high, high_mask));
+        }
+
+        // set the PC of the lanes in mask to next, or to skip for the lanes also in skip_lanes
+        __attribute__((target("avx2"))) void advance(uint16_t *pcs, __m256i next, __m256i skip, Bytes skip_lanes, Bytes mask) {
+            const auto low = _mm256_blendv_epi8(next, skip, _mm256_cvtepi8_epi16(_mm256_castsi256_si128(skip_lanes)));
+            const auto high = _mm256_blendv_epi8(next, skip, _mm256_cvtepi8_epi16(_mm256_extracti128_si256(skip_lanes, 1)));
+            store_lanes(pcs, low, high, mask);
+        }
+
+        // 1 where a >= b, 0 otherwise (unsigned)
+        __attribute__((target("avx2"))) Bytes greater_equal(Bytes a, Bytes b) {
+            return _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(a, b), a), _mm256_set1_epi8(1));
+        }
+    } // namespace
+
+
+    __attribute__((target("avx2"))) bool Lockstep::exec_group_avx2(uint16_t group_pc, uint16_t opcode) {
+        const auto x = X(opcode);
+        const auto y = Y(opcode);
+        const auto kind = get4Bit(opcode, 12);
+        const auto low_byte = nn(opcode);
+        // instructions without SIMD implementation
+        const auto arithmetic = kind == 0x8 && (n(opcode) <= 0x7 || n(opcode) == 0xE);
+        const auto timer_or_i = kind == 0xF && (low_byte == 0x07 || low_byte == 0x15 || low_byte == 0x18 || low_byte == 0x1E);
+        if (!(kind == 0x1 || (kind >= 0x3 && kind <= 0x7) || arithmetic || kind == 0x9 || kind == 0xA || timer_or_i)) {
+            return false;
+        }
+
+        const auto next = next_pc(group_pc);
+        const auto next_words = _mm256_set1_epi16(static_cast<short>(next));
+        const auto skip_words = _mm256_set1_epi16(static_cast<short>(next_pc(next)));
+        const auto nn_bytes = _mm256_set1_epi8(static_cast<char>(low_byte));
+        const auto nnn_words = _mm256_set1_epi16(static_cast<short>(nnn(opcode)));
+        const auto ones = _mm256_set1_epi8(1);
+        const auto shift_source_vy = config.shift_vy;
+
+        for (std::size_t base = 0; base < stride; base += lane_block) {
+            const auto mask = load(&group[base]);
+            if (_mm256_testz_si256(mask, mask) != 0) { continue; }
+            auto *vx = &registers[x * stride + base];
+            auto *vy = &registers[y * stride + base];
+            auto *vf = &registers[VF * stride + base];
+            auto *pcs = &pc[base];
+            const auto a = load(vx);
+            const auto b = load(vy);
+
+            // the PC first like Chip8, skips advance by another instruction
+            if (kind == 0x1) {
+                store_lanes(pcs, nnn_words, nnn_words, mask);
+            } else {
+                auto skip = _mm256_setzero_si256();
+                if (kind == 0x3) { skip = _mm256_cmpeq_epi8(a, nn_bytes); }
+                if (kind == 0x4) { skip = _mm256_andnot_si256(_mm256_cmpeq_epi8(a, nn_bytes), mask); }
+                if (kind == 0x5) { skip = _mm256_cmpeq_epi8(a, b); }
+                if (kind == 0x9) { skip = _mm256_andnot_si256(_mm256_cmpeq_epi8(a, b), mask); }
+                advance(pcs, next_words, skip_words, skip, mask);
+            }
+
+            switch (kind) {
+                case 0x6: store_lanes(vx, nn_bytes, mask); break;
+                case 0x7: store_lanes(vx, _mm256_add_epi8(a, nn_bytes), mask); break;
+                case 0xA: store_lanes(&index[base], nnn_words, nnn_words, mask); break;
+                case 0x8: {
+                    // read again after writing VF, which may be the source
+                    const auto *source = shift_source_vy ? vy : vx;
+                    switch (n(opcode)) {
+                        case 0x0: store_lanes(vx, b, mask); break;
+                        case 0x1: store_lanes(vx, _mm256_or_si256(a, b), mask); break;
+                        case 0x2: store_lanes(vx, _mm256_and_si256(a, b), mask); break;
+                        case 0x3: store_lanes(vx, _mm256_xor_si256(a, b), mask); break;
+                        case 0x4: {
+                            const auto sum = _mm256_add_epi8(a, b);
+                            // the saturated sum differs from the wrapped one on a carry
+                            const auto carry = _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_adds_epu8(a, b), sum), ones);
+                            store_lanes(vx, sum, mask);
+                            store_lanes(vf, carry, mask);
+                            break;
+                        }
+                        case 0x5: {
+                            const auto difference = _mm256_sub_epi8(a, b);
+                            store_lanes(vx, difference, mask);
+                            store_lanes(vf, greater_equal(a, difference), mask);
+                            break;
+                        }
+                        case 0x6:
+                            store_lanes(vf, _mm256_and_si256(load(source), ones), mask);
+                            store_lanes(vx, _mm256_and_si256(_mm256_srli_epi16(load(source), 1), _mm256_set1_epi8(0x7F)), mask);
+                            break;
+                        case 0x7: {
+                            const auto difference = _mm256_sub_epi8(b, a);
+                            store_lanes(vx, difference, mask);
+                            store_lanes(vf, greater_equal(b, difference), mask);
+                            break;
+                        }
+                        default: // 0xE
+                            store_lanes(vf, _mm256_and_si256(_mm256_srli_epi16(load(source), 7), ones), mask);
+                            store_lanes(vx, _mm256_add_epi8(load(source), load(source)), mask);
+                            break;
+                    }
+                    break;
+                }
+                case 0xF:
+                    if (low_byte == 0x07) {
+                        store_lanes(vx, load(&delay_timer[base]), mask);
+                    } else if (low_byte == 0x15) {
+                        store_lanes(&delay_timer[base], a, mask);
+                    } else if (low_byte == 0x18) {
+                        store_lanes(&sound_timer[base], a, mask);
+                    } else {
+                        auto *i = &index[base];
+                        const auto low = _mm256_add_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(i)), // NOLINT intrinsic load
+                                                          _mm256_cvtepu8_epi16(_mm256_castsi256_si128(a)));
+                        const auto high = _mm256_add_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(i + 16)), // NOLINT intrinsic load
+                                                           _mm256_cvtepu8_epi16(_mm256_extracti128_si256(a, 1)));
+                        store_lanes(i, low, high, mask);
+                    }
+                    break;
+                default: break;
+            }
+        }
+        return true;
+    }
+
+#else
+
+    bool Lockstep::find_group(uint16_t &, uint16_t &) { return false; }
+    bool Lockstep::exec_group_avx2(uint16_t, uint16_t) { return false; }
+
+#endif
+
+} // namespace chip8
@@ -0,0 +1,257 @@
+#include "chip8/Movie.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+#include <gsl/narrow>
+#include <spdlog/spdlog.h>
+
+namespace chip8 {
+
+    static constexpr std::array<char, 4> movie_magic{'C', '8', 'M', 'V'};
+
+    static void write_number(std::ostream &out, uint64_t value) {
+        // LEB128: 7 bits per byte, the high bit marks that more bytes follow
+        do {
+            auto byte = static_cast<uint8_t>(value & 0x7FU);
+            value >>= 7U;
+            if (value != 0) { byte |= 0x80U; }
+            out.put(static_cast<char>(byte));
+        } while (value != 0);
+    }
+
+    static void write_u64(std::ostream &out, uint64_t value) {
+        for (unsigned byte = 0; byte < 8; byte++) { out.put(static_cast<char>(value >> (8U * byte))); }
+    }
+
+    static std::optional<uint64_t> read_number(std::istream &in) {
+        uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            const auto byte = in.get();
+            if (byte == std::istream::traits_type::eof()) { return std::nullopt; }
+            value |= (static_cast<uint64_t>(byte) & 0x7FU) << shift;
+            if ((static_cast<unsigned>(byte) & 0x80U) == 0) { return value; }
+        }
+        return std::nullopt;
+    }
+
+    static std::optional<uint64_t> read_u64(std::istream &in) {
+        uint64_t value = 0;
+        for (unsigned byte = 0; byte < 8; byte++) {
+            const auto data = in.get();
+            if (data == std::istream::traits_type::eof()) { return std::nullopt; }
+            value |= static_cast<uint64_t>(data) << (8U * byte);
+        }
+        return value;
+    }
+
+
+    uint64_t Movie::frame_count() const {
+        uint64_t count = 0;
+        for (const auto &frame_run: frames) { count += frame_run.count; }
+        return count;
+    }
+
+
+    bool Movie::write(std::ostream &out) const {
+        out.write(movie_magic.data(), movie_magic.size());
+        write_number(out, current_version);
+        write_u64(out, rom_hash);
+        write_number(out, rom_size);
+        write_u64(out, seed);
+        write_number(out, shift_vy ? 1 : 0);
+        write_number(out, stack_depth);
+        write_number(out, frames.size());
+        for (const auto &frame_run: frames) {
+            write_number(out, frame_run.count);
+            write_number(out, static_cast<uint64_t>(frame_run.instructions));
+        }
+        write_number(out, key_changes.size());
+        uint64_t tick = 0;
+        for (const auto &change: key_changes) {
+            write_number(out, change.tick - tick);
+            write_number(out, change.keys);
+            tick = change.tick;
+        }
+        write_number(out, end_tick);
+        write_u64(out, end_state_hash);
+        return static_cast<bool>(out);
+    }
+
+
+    std::optional<Movie> Movie::read(std::istream &in) {
+        const auto invalid = [](const char *reason) {
+            spdlog::error("Invalid movie: {}", reason);
+            return std::nullopt;
+        };
+        std::array<char, 4> magic{};
+        if (!in.read(magic.data(), magic.size()) || magic != movie_magic) { return invalid("not a Chip8 movie"); }
+        const auto version = read_number(in);
+        if (!version || *version != current_version) {
+            spdlog::error("Unsupported movie version {}, expected version {}", version.value_or(0), current_version);
+            return std::nullopt;
+        }
+
+        Movie movie;
+        // a value of the header or std::nullopt, the stream stays failed after the first error
+        const auto hash = read_u64(in);
+        const auto size = read_number(in);
+        const auto seed = read_u64(in);
+        const auto shift_vy = read_number(in);
+        const auto stack_depth = read_number(in);
+        const auto runs = read_number(in);
+        if (!hash || !size || !seed || !shift_vy || !stack_depth || !runs) { return invalid("truncated header"); }
+        movie.rom_hash = *hash;
+        movie.rom_size = *size;
+        movie.seed = *seed;
+        movie.shift_vy = *shift_vy != 0;
+        movie.stack_depth = *stack_depth;
+
+        for (uint64_t idx = 0; idx < *runs; idx++) {
+            const auto count = read_number(in);
+            const auto instructions = read_number(in);
+            if (!count || !instructions || *instructions > uint64_t{std::numeric_limits<int>::max()}) { return invalid("truncated frames"); }
+            movie.frames.push_back({*count, static_cast<int>(*instructions)});
+        }
+        const auto changes = read_number(in);
+        if (!changes) { return invalid("truncated key changes"); }
+        uint64_t tick = 0;
+        for (uint64_t idx = 0; idx < *changes; idx++) {
+            const auto delta = read_number(in);
+            const auto keys = read_number(in);
+            if (!delta || !keys || *keys > 0xFFFFU) { return invalid("truncated key changes"); }
+            tick += *delta;
+            movie.key_changes.push_back({tick, static_cast<uint16_t>(*keys)});
+        }
+        const auto end_tick = read_number(in);
+        const auto end_state_hash = read_u64(in);
+        if (!end_tick || !end_state_hash) { return invalid("truncated end state"); }
+        movie.end_tick = *end_tick;
+        movie.end_state_hash = *end_state_hash;
+        return movie;
+    }
+
+
+    MovieRecorder::MovieRecorder(const Chip8 &chip8) {
+        movie.rom_hash = chip8.get_rom_hash();
+        movie.rom_size = chip8.get_rom_size();
+        movie.seed = chip8.get_seed();
+        movie.shift_vy = chip8.get_shift_implementation();
+        movie.stack_depth = chip8.get_stack_depth();
+        // the player starts with all keys released
+        if (chip8.get_key_mask() != 0) { movie.key_changes.push_back({0, chip8.get_key_mask()}); }
+    }
+
+
+    void MovieRecorder::record_frame(const Chip8 &chip8, uint16_t keys, int instructions) {
+        if (chip8.get_state() != State::Running) { return; }
+        // compared with the keys of the chip8, FX0A releases the key it waited for
+        if (keys != chip8.get_key_mask()) { movie.key_changes.push_back({chip8.get_tick_count(), keys}); }
+        if (movie.frames.empty() || movie.frames.back().instructions != instructions) {
+            movie.frames.push_back({0, instructions});
+        }
+        movie.frames.back().count++;
+    }
+
+
+    Movie MovieRecorder::finish(const Chip8 &chip8) const {
+        auto finished = movie;
+        finished.end_tick = chip8.get_tick_count();
+        finished.end_state_hash = chip8.state_hash();
+        return finished;
+    }
+
+
+    bool MoviePlayer::start(Chip8 &chip8) {
+        if (chip8.get_rom_hash() != movie.rom_hash || chip8.get_rom_size() != movie.rom_size) {
+            spdlog::error("The movie was recorded with another ROM");
+            return false;
+        }
+        chip8.set_seed(movie.seed);
+        chip8.set_shift_implementation(movie.shift_vy);
+        chip8.set_stack_depth(movie.stack_depth);
+        chip8.reset_rom();
+        chip8.toggle_pause();
+        chip8.set_key_mask(0);
+        position = {};
+        saved.clear();
+        checkpoint(chip8);
+        return true;
+    }
+
+
+    bool MoviePlayer::play_frame(Chip8 &chip8) {
+        if (finished() || chip8.get_state() != State::Running) { return false; }
+        return advance(chip8, std::numeric_limits<uint64_t>::max());
+    }
+
+
+    bool MoviePlayer::play_until(Chip8 &chip8, uint64_t tick) {
+        while (chip8.get_tick_count() < tick) {
+            if (finished() || chip8.get_state() != State::Running) { return false; }
+            advance(chip8, tick);
+        }
+        return chip8.get_tick_count() == tick;
+    }
+
+
+    bool MoviePlayer::seek(Chip8 &chip8, uint64_t tick) {
+        if (saved.empty()) { return false; }
+        const auto after = std::upper_bound(saved.begin(), saved.end(), tick, [](uint64_t target, const Checkpoint &checkpoint) {
+            return target < checkpoint.state.tick_count;
+        });
+        const auto &nearest = after == saved.begin() ? saved.front() : *std::prev(after);
+        // going on from the current tick is shorter when it lies between the checkpoint and the target
+        const auto current = chip8.get_tick_count();
+        if (chip8.get_state() != State::Running || current > tick || current < nearest.state.tick_count) {
+            if (!chip8.load_state(nearest.state)) { return false; }
+            position = nearest.position;
+        }
+        return play_until(chip8, tick);
+    }
+
+
+    bool MoviePlayer::advance(Chip8 &chip8, uint64_t tick) {
+        if (position.frame_left == 0) {
+            if (position.run == movie.frames.size()) { return false; }
+            checkpoint(chip8);
+            position.frame_left = movie.frames[position.run].instructions;
+            if (++position.frame_in_run == movie.frames[position.run].count) {
+                position.run++;
+                position.frame_in_run = 0;
+            }
+            chip8.signal();
+        }
+
+        // like Chip8::tick, the instructions are run up to each key change
+        while (true) {
+            const auto current = chip8.get_tick_count();
+            const auto &changes = movie.key_changes;
+            for (; position.next_key_change < changes.size() && changes[position.next_key_change].tick <= current; position.next_key_change++) {
+                chip8.set_key_mask(changes[position.next_key_change].keys);
+            }
+            if (position.frame_left == 0 || current >= tick || chip8.get_state() != State::Running) { break; }
+            auto until = tick;
+            if (position.next_key_change < changes.size()) { until = std::min(until, changes[position.next_key_change].tick); }
+            const auto instructions = gsl::narrow_cast<int>(std::min<uint64_t>(until - current, static_cast<uint64_t>(position.frame_left)));
+            chip8.run_instructions(instructions);
+            position.frame_left -= instructions;
+        }
+        return chip8.get_state() == State::Running;
+    }
+
+
+    void MoviePlayer::checkpoint(const Chip8 &chip8) {
+        const auto tick = chip8.get_tick_count();
+        // seeking back and playing again passes checkpoints that already exist
+        if (!saved.empty() && tick < saved.back().state.tick_count + checkpoint_interval) { return; }
+        saved.push_back({position, chip8.save_state()});
+    }
+
+
+    bool MoviePlayer::matches(const Chip8 &chip8) const {
+        return chip8.get_tick_count() == movie.end_tick && chip8.state_hash() == movie.end_state_hash;
+    }
+
+} // namespace chip8
@@ -0,0 +1,163 @@
+#include "chip8/PixelExpansion.h"
+
+#include <bit>
+#include <cassert>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define CHIP8_PIXELS_X86_64
+#include <immintrin.h>
+#endif
+
+namespace chip8::pixels {
+
+    static constexpr std::size_t row_width = 64;
+
+    // byte k of the value is 0xFF if bit k of the index is set, in memory order
+    static constexpr auto make_expansion_table() {
+        std::array<uint64_t, 256> table{};
+        for (std::size_t value = 0; value < table.size(); value++) {
+            for (std::size_t bit = 0; bit < 8; bit++) {
+                if (((value >> bit) & 1U) == 0) { continue; }
+                const auto byte = std::endian::native == std::endian::little ? bit : 7 - bit;
+                table[value] |= uint64_t{0xFF} << (8 * byte);
+            }
+        }
+        return table;
+    }
+
+    static void expand_scalar(std::span<const uint64_t> rows, uint8_t *out) {
+        static constexpr auto table = make_expansion_table();
+        for (const auto row: rows) {
+            for (std::size_t byte = 0; byte < 8; byte++) {
+                const auto expanded = table[(row >> (8 * byte)) & 0xFFU];
+                std::memcpy(out, &expanded, sizeof(expanded));
+                out += sizeof(expanded);
+            }
+        }
+    }
+
+    // A pixel is off ^ ((off ^ on) & mask), the mask of a pixel is all ones if its bit is set.
+    // Pixels are written in display order, the most significant bit of a row first.
+    static void expand_rgba_scalar(std::span<const uint64_t> rows, uint8_t *out, uint32_t off, uint32_t on) {
+        const auto difference = off ^ on;
+        std::array<uint32_t, row_width> colors{};
+        for (const auto row: rows) {
+            for (std::size_t x = 0; x < row_width; x++) {
+                const auto bit = static_cast<uint32_t>(row >> (row_width - 1 - x)) & 1U;
+                colors[x] = off ^ (difference & (0U - bit));
+            }
+            std::memcpy(out, colors.data(), sizeof(colors));
+            out += sizeof(colors);
+        }
+    }
+
+#ifdef CHIP8_PIXELS_X86_64
+
+    // byte k holds bit k, so comparing the masked broadcast bytes with it yields 0xFF or 0x00
+    static constexpr auto bit_of_byte = static_cast<long long>(0x8040201008040201ULL);
+
+    static void expand_sse2(std::span<const uint64_t> rows, uint8_t *out) {
+        const auto mask = _mm_set1_epi64x(bit_of_byte);
+        for (const auto row: rows) {
+            for (std::size_t pair = 0; pair < 4; pair++) {
+                const auto low = (row >> (16 * pair)) & 0xFFU;
+                const auto high = (row >> (16 * pair + 8)) & 0xFFU;
+                // every byte of a 64 bit lane holds the same 8 pixels
+                const auto spread = _mm_set_epi64x(static_cast<long long>(high * 0x0101010101010101ULL),
+                                                   static_cast<long long>(low * 0x0101010101010101ULL));
+                const auto pixels = _mm_cmpeq_epi8(_mm_and_si128(spread, mask), mask);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out), pixels); // NOLINT intrinsic store
+                out += 16;
+            }
+        }
+    }
+
+    __attribute__((target("avx2"))) static void expand_avx2(std::span<const uint64_t> rows, uint8_t *out) {
+        const auto mask = _mm256_set1_epi64x(bit_of_byte);
+        // byte n of the result gets byte n / 8 of the broadcast 32 bit word
+        const auto spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                             2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+        for (const auto row: rows) {
+            for (std::size_t half = 0; half < 2; half++) {
+                const auto word = static_cast<int>(static_cast<uint32_t>(row >> (32 * half)));
+                const auto bytes = _mm256_shuffle_epi8(_mm256_set1_epi32(word), spread);
+                const auto pixels = _mm256_cmpeq_epi8(_mm256_and_si256(bytes, mask), mask);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), pixels); // NOLINT intrinsic store
+                out += 32;
+            }
+        }
+    }
+
+    // lane k of the mask is all ones if bit k of the broadcast pixels is set, leftmost pixel in lane 0
+    static void expand_rgba_sse2(std::span<const uint64_t> rows, uint8_t *out, uint32_t off, uint32_t on) {
+        const auto off_color = _mm_set1_epi32(static_cast<int>(off));
+        const auto difference = _mm_set1_epi32(static_cast<int>(off ^ on));
+        const auto bit_of_lane = _mm_setr_epi32(8, 4, 2, 1);
+        for (const auto row: rows) {
+            for (std::size_t nibble = 0; nibble < row_width / 4; nibble++) {
+                const auto pixels = static_cast<int>((row >> (row_width - 4 - 4 * nibble)) & 0xFU);
+                const auto mask = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(pixels), bit_of_lane), bit_of_lane);
+                const auto colors = _mm_xor_si128(off_color, _mm_and_si128(difference, mask));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out), colors); // NOLINT intrinsic store
+                out += 16;
+            }
+        }
+    }
+
+    __attribute__((target("avx2"))) static void expand_rgba_avx2(std::span<const uint64_t> rows, uint8_t *out,
+                                                                 uint32_t off, uint32_t on) {
+        const auto off_color = _mm256_set1_epi32(static_cast<int>(off));
+        const auto difference = _mm256_set1_epi32(static_cast<int>(off ^ on));
+        const auto bit_of_lane = _mm256_setr_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+        for (const auto row: rows) {
+            for (std::size_t byte = 0; byte < row_width / 8; byte++) {
+                const auto pixels = static_cast<int>((row >> (row_width - 8 - 8 * byte)) & 0xFFU);
+                const auto mask = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(pixels), bit_of_lane), bit_of_lane);
+                const auto colors = _mm256_xor_si256(off_color, _mm256_and_si256(difference, mask));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), colors); // NOLINT intrinsic store
+                out += 32;
+            }
+        }
+    }
+
+#endif
+
+    Kernel best_kernel() {
+#ifdef CHIP8_PIXELS_X86_64
+        static const auto kernel = __builtin_cpu_supports("avx2") ? Kernel::Avx2 : Kernel::Sse2;
+        return kernel;
+#else
+        return Kernel::Scalar;
+#endif
+    }
+
+
+    void expand_rows(std::span<const uint64_t> rows, std::span<uint8_t> out, Kernel kernel) {
+        assert(out.size() >= rows.size() * row_width);
+        switch (kernel) {
+#ifdef CHIP8_PIXELS_X86_64
+            case Kernel::Avx2: expand_avx2(rows, out.data()); break;
+            case Kernel::Sse2: expand_sse2(rows, out.data()); break;
+#endif
+            default: expand_scalar(rows, out.data()); break;
+        }
+    }
+
+
+    void expand_rows_rgba(std::span<const uint64_t> rows, std::span<uint8_t> out, const Palette &palette, Kernel kernel) {
+        assert(out.size() >= rows.size() * row_width * 4);
+        uint32_t off = 0;
+        uint32_t on = 0;
+        std::memcpy(&off, &palette.off, sizeof(off));
+        std::memcpy(&on, &palette.on, sizeof(on));
+        switch (kernel) {
+#ifdef CHIP8_PIXELS_X86_64
+            case Kernel::Avx2: expand_rgba_avx2(rows, out.data(), off, on); break;
+            case Kernel::Sse2: expand_rgba_sse2(rows, out.data(), off, on); break;
+#endif
+            default: expand_rgba_scalar(rows, out.data(), off, on); break;
+        }
+    }
+
+} // namespace chip8::pixels
@@ -0,0 +1,203 @@
+#include "chip8/Rewind.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <optional>
+
+#include <gsl/narrow>
+
+namespace chip8 {
+
+    static constexpr std::size_t state_size = sizeof(Chip8::SaveState);
+    // equal bytes shorter than this stay in a literal run, a zero run costs a header of 4 bytes
+    static constexpr std::size_t min_zero_run = 4;
+    static_assert(state_size <= std::numeric_limits<uint16_t>::max(), "run lengths are stored as uint16");
+
+    static uint8_t *bytes_of(Chip8::SaveState &state) {
+        return reinterpret_cast<uint8_t *>(&state); // NOLINT the save state is plain data
+    }
+
+    static void write_u16(uint8_t *out, std::size_t value) {
+        out[0] = gsl::narrow_cast<uint8_t>(value);
+        out[1] = gsl::narrow_cast<uint8_t>(value >> 8U);
+    }
+
+    static std::size_t read_u16(const uint8_t *in) {
+        return in[0] | (std::size_t{in[1]} << 8U);
+    }
+
+    // Encode previous XOR current as runs: 2 bytes number of zero bytes, 2 bytes number of literal
+    // bytes, the literal bytes. Returns the encoded size, std::nullopt if it would exceed capacity.
+    static std::optional<std::size_t> encode_delta(const uint8_t *previous, const uint8_t *current, uint8_t *out,
+                                                   std::size_t capacity) {
+        std::size_t size = 0;
+        std::size_t pos = 0;
+        while (pos < state_size) {
+            const auto zeros_start = pos;
+            // unchanged memory is skipped a word at a time
+            while (pos + 8 <= state_size && std::memcmp(previous + pos, current + pos, 8) == 0) { pos += 8; }
+            while (pos < state_size && previous[pos] == current[pos]) { pos++; }
+            if (pos == state_size) { break; }
+
+            const auto literal_start = pos;
+            while (pos < state_size) {
+                if (previous[pos] != current[pos]) {
+                    pos++;
+                    continue;
+                }
+                auto run_end = pos;
+                while (run_end < state_size && run_end - pos < min_zero_run && previous[run_end] == current[run_end]) { run_end++; }
+                if (run_end - pos >= min_zero_run || run_end == state_size) { break; }
+                pos = run_end;
+            }
+
+            const auto literals = pos - literal_start;
+            if (size + 4 + literals > capacity) { return std::nullopt; }
+            write_u16(out + size, literal_start - zeros_start);
+            write_u16(out + size + 2, literals);
+            size += 4;
+            for (auto idx = literal_start; idx < pos; idx++) { out[size++] = previous[idx] ^ current[idx]; }
+        }
+        return size;
+    }
+
+    // state XOR= the encoded delta, turns the state before the delta into the one after it and back
+    static void apply_delta(const uint8_t *in, std::size_t size, uint8_t *state) {
+        std::size_t pos = 0;
+        for (std::size_t read = 0; read < size;) {
+            pos += read_u16(in + read);
+            const auto literals = read_u16(in + read + 2);
+            read += 4;
+            for (std::size_t idx = 0; idx < literals; idx++) { state[pos++] ^= in[read++]; }
+        }
+    }
+
+
+    Rewind::Rewind(const Config &t_config)
+            : config(t_config),
+              arena(std::max(t_config.arena_bytes, 2 * state_size)),
+              entries(std::max<std::size_t>(t_config.max_frames, 2)) {
+        config.keyframe_interval = std::max<std::size_t>(config.keyframe_interval, 1);
+    }
+
+
+    void Rewind::clear() {
+        oldest = 0;
+        count = 0;
+        tail = 0;
+        since_keyframe = 0;
+        keyframes = 0;
+        stored_bytes = 0;
+    }
+
+
+    void Rewind::capture(const Chip8 &chip8) {
+        const auto start = std::chrono::steady_clock::now();
+        chip8.save_state(scratch);
+
+        if (count == entries.size()) { drop_oldest_keyframe(); }
+        // room for a keyframe, a delta is stored as keyframe when it would be bigger
+        const auto offset = allocate(state_size);
+        auto *out = &arena[offset];
+        std::optional<std::size_t> delta_size;
+        if (count != 0 && since_keyframe + 1 < config.keyframe_interval) {
+            delta_size = encode_delta(bytes_of(newest), bytes_of(scratch), out, state_size);
+        }
+        if (delta_size) {
+            push({gsl::narrow_cast<uint32_t>(offset), gsl::narrow_cast<uint32_t>(*delta_size), false});
+            since_keyframe++;
+        } else {
+            std::memcpy(out, bytes_of(scratch), state_size);
+            push({gsl::narrow_cast<uint32_t>(offset), gsl::narrow_cast<uint32_t>(state_size), true});
+            since_keyframe = 0;
+        }
+        newest = scratch;
+
+        captures++;
+        capture_nanoseconds += static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+
+
+    bool Rewind::step_back(Chip8 &chip8) {
+        if (count < 2) { return false; }
+        const auto dropped = entry(count - 1);
+        count--;
+        stored_bytes -= dropped.size;
+        tail = entry(count - 1).offset + entry(count - 1).size;
+
+        if (!dropped.keyframe) {
+            apply_delta(&arena[dropped.offset], dropped.size, bytes_of(newest));
+            since_keyframe--;
+        } else {
+            keyframes--;
+            // the oldest frame is always a keyframe
+            auto keyframe = count - 1;
+            while (!entry(keyframe).keyframe) { keyframe--; }
+            std::memcpy(bytes_of(newest), &arena[entry(keyframe).offset], state_size);
+            for (auto index = keyframe + 1; index < count; index++) {
+                apply_delta(&arena[entry(index).offset], entry(index).size, bytes_of(newest));
+            }
+            since_keyframe = count - 1 - keyframe;
+        }
+        return chip8.load_state(newest);
+    }
+
+
+    Rewind::Stats Rewind::get_stats() const {
+        Stats stats;
+        stats.frames = count;
+        stats.keyframes = keyframes;
+        stats.bytes = stored_bytes;
+        stats.arena_bytes = arena.size();
+        stats.capture_nanoseconds = captures == 0 ? 0.0 : static_cast<double>(capture_nanoseconds) / static_cast<double>(captures);
+        return stats;
+    }
+
+
+    // The frames form one contiguous range of the arena that may wrap around at the end. A frame
+    // that does not fit before the end starts at offset 0, the rest of the arena stays unused.
+    std::size_t Rewind::allocate(std::size_t length) {
+        while (count != 0) {
+            const std::size_t head = entry(0).offset;
+            if (head < tail) {
+                if (arena.size() - tail >= length) { return tail; }
+                // the new tail has to stay below head, otherwise a full arena looks empty
+                if (head > length) { return 0; }
+            } else if (head - tail > length) {
+                return tail;
+            }
+            drop_oldest_keyframe();
+        }
+        tail = 0;
+        return 0;
+    }
+
+
+    void Rewind::push(const Entry &new_entry) {
+        entry(count) = new_entry;
+        count++;
+        tail = new_entry.offset + new_entry.size;
+        stored_bytes += new_entry.size;
+        if (new_entry.keyframe) { keyframes++; }
+    }
+
+
+    void Rewind::drop_oldest() {
+        const auto &dropped = entry(0);
+        stored_bytes -= dropped.size;
+        if (dropped.keyframe) { keyframes--; }
+        oldest = (oldest + 1) % entries.size();
+        count--;
+    }
+
+
+    void Rewind::drop_oldest_keyframe() {
+        drop_oldest();
+        while (count != 0 && !entry(0).keyframe) { drop_oldest(); }
+        if (count == 0) { clear(); }
+    }
+
+} // namespace chip8
@@ -0,0 +1,47 @@
+#include "chip8/RunAhead.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace chip8 {
+
+    void RunAhead::set_frames(int t_frames) {
+        frames = std::clamp(t_frames, 0, max_frames);
+        reset_measurement();
+    }
+
+
+    bool RunAhead::run(Chip8 &chip8, int instructions, std::size_t display_consumer, Chip8::DisplayRows &rows,
+                       Chip8::DirtyRows &dirty_rows) {
+        if (frames == 0 || chip8.get_state() != State::Running) { return false; }
+        const auto start = std::chrono::steady_clock::now();
+        chip8.save_state(saved);
+        history = chip8.get_call_stack();
+        // a fault ahead has not happened yet, it is logged when the emulation gets there
+        const auto fault_logging = chip8.get_fault_logging();
+        chip8.set_fault_logging(false);
+        // the keys of chip8 are the current ones, held for all frames ahead
+        for (int frame = 0; frame < frames && chip8.get_state() == State::Running; frame++) { chip8.tick(instructions); }
+        rows = chip8.get_display_rows();
+        dirty_rows |= chip8.take_dirty_rows(display_consumer);
+        chip8.set_fault_logging(fault_logging);
+        chip8.load_state(saved, history);
+
+        runs++;
+        nanoseconds += static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        return true;
+    }
+
+
+    double RunAhead::get_nanoseconds() const {
+        return runs == 0 ? 0.0 : static_cast<double>(nanoseconds) / static_cast<double>(runs);
+    }
+
+
+    void RunAhead::reset_measurement() {
+        runs = 0;
+        nanoseconds = 0;
+    }
+
+} // namespace chip8
@@ -0,0 +1,182 @@
+#include "chip8/Search.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <memory>
+#include <unordered_set>
+#include <utility>
+
+#include "utilities/Hash.h"
+#include "utilities/WorkStealingPool.h"
+
+namespace chip8::search {
+
+    // a task expands this many states with one Chip8, creating it is more expensive than a step
+    static constexpr std::size_t states_per_task = 64;
+
+    static constexpr uint16_t branch_keys(std::size_t branch) {
+        return branch == 0 ? uint16_t{0} : static_cast<uint16_t>(1U << (branch - 1));
+    }
+
+    // Every child is hashed, byte wise like Chip8::state_hash() that takes longer than running its
+    // frames. The save state is hashed a word at a time instead, FNV-1a with a rotation so the high
+    // bits of a word reach the low bits of the hash. The held keys are part of the save state, they
+    // decide how a waiting FX0A continues; the tick count is not, equal states on different levels
+    // are the same state.
+    static uint64_t hash_state(Chip8::SaveState &state) {
+        static_assert(sizeof(Chip8::SaveState) % sizeof(uint64_t) == 0);
+        state.tick_count = 0;
+        const auto *bytes = reinterpret_cast<const uint8_t *>(&state); // NOLINT the save state is plain data
+        auto hash = fnv1a_offset_basis;
+        for (std::size_t offset = 0; offset < sizeof(state); offset += sizeof(uint64_t)) {
+            uint64_t word = 0;
+            std::memcpy(&word, bytes + offset, sizeof(word));
+            hash = std::rotl((hash ^ word) * fnv1a_prime, 27);
+        }
+        return hash;
+    }
+
+    static std::unique_ptr<Chip8> make_chip8(std::span<const uint8_t> rom, const Config &config) {
+        auto chip8 = std::make_unique<Chip8>();
+        chip8->set_backend(config.backend);
+        chip8->set_idle_skipping(config.idle_skipping);
+        chip8->load_rom(rom);
+        return chip8;
+    }
+
+    // run a step from state, returns the frames run
+    static std::size_t step(Chip8 &chip8, const Chip8::SaveState &state, uint16_t keys, std::size_t frames) {
+        chip8.load_state(state);
+        chip8.set_key_mask(keys);
+        std::size_t frame = 0;
+        for (; frame < frames && chip8.get_state() == State::Running; frame++) { chip8.tick(); }
+        return frame;
+    }
+
+
+    Result find_shortest_path(std::span<const uint8_t> rom, const Chip8::SaveState &start, const Goal &goal,
+                              const Config &config) {
+        // every state visited: its parent and the keys of the step from the parent, 0 is the start
+        struct Node {
+            std::size_t parent = 0;
+            uint16_t keys = 0;
+        };
+        struct Child {
+            uint64_t hash = 0;
+            bool running = false;
+            bool goal = false;
+        };
+        // a child state that is new, by index into the children of the level
+        struct Kept {
+            std::size_t child = 0;
+            std::size_t node = 0;
+        };
+
+        Result result;
+        std::vector<Node> nodes{Node{}};
+        std::unordered_set<uint64_t> seen;
+        const auto path_to = [&nodes](std::size_t node) {
+            std::vector<uint16_t> path;
+            for (; node != 0; node = nodes[node].parent) { path.push_back(nodes[node].keys); }
+            std::ranges::reverse(path);
+            return path;
+        };
+        {
+            const auto chip8 = make_chip8(rom, config);
+            chip8->load_state(start);
+            auto state = start;
+            seen.insert(hash_state(state));
+            if (goal(*chip8)) {
+                result.found = true;
+                result.states = seen.size();
+                return result;
+            }
+        }
+
+        WorkStealingPool pool(config.threads);
+        const auto tasks = [](std::size_t states) { return (states + states_per_task - 1) / states_per_task; };
+        const auto frames = std::max<std::size_t>(config.frames_per_step, 1);
+        std::atomic<std::size_t> frames_run{0};
+        std::vector<Chip8::SaveState> level{start};
+        std::vector<std::size_t> level_nodes{0};
+        while (!level.empty() && result.steps < config.max_steps) {
+            result.steps++;
+            std::vector<Child> children(level.size() * branches);
+            pool.run(tasks(level.size()), [&](std::size_t task) {
+                const auto chip8 = make_chip8(rom, config);
+                const auto end = std::min(level.size(), (task + 1) * states_per_task);
+                std::size_t run = 0;
+                Chip8::SaveState state;
+                for (auto index = task * states_per_task; index < end; index++) {
+                    for (std::size_t branch = 0; branch < branches; branch++) {
+                        run += step(*chip8, level[index], branch_keys(branch), frames);
+                        auto &child = children[index * branches + branch];
+                        chip8->save_state(state);
+                        child.hash = hash_state(state);
+                        child.running = chip8->get_state() == State::Running;
+                        child.goal = goal(*chip8);
+                    }
+                }
+                frames_run += run;
+            });
+
+            // duplicates are removed in order, so the result does not depend on the threads
+            std::vector<Kept> kept;
+            for (std::size_t index = 0; index < children.size(); index++) {
+                const auto &child = children[index];
+                if (!seen.insert(child.hash).second) { continue; }
+                nodes.push_back({level_nodes[index / branches], branch_keys(index % branches)});
+                if (child.goal) {
+                    result.found = true;
+                    result.path = path_to(nodes.size() - 1);
+                    break;
+                }
+                if (child.running) { kept.push_back({index, nodes.size() - 1}); }
+                if (seen.size() >= config.max_states) { break; }
+            }
+            if (result.found || seen.size() >= config.max_states) { break; }
+
+            std::vector<Chip8::SaveState> next(kept.size());
+            pool.run(tasks(kept.size()), [&](std::size_t task) {
+                const auto chip8 = make_chip8(rom, config);
+                const auto end = std::min(kept.size(), (task + 1) * states_per_task);
+                std::size_t run = 0;
+                for (auto index = task * states_per_task; index < end; index++) {
+                    const auto child = kept[index].child;
+                    run += step(*chip8, level[child / branches], branch_keys(child % branches), frames);
+                    chip8->save_state(next[index]);
+                }
+                frames_run += run;
+            });
+            level = std::move(next);
+            level_nodes.resize(kept.size());
+            std::ranges::transform(kept, level_nodes.begin(), &Kept::node);
+        }
+        result.states = seen.size();
+        result.frames = frames_run;
+        return result;
+    }
+
+
+    std::vector<batch::InputEvent> to_input(std::span<const uint16_t> path, std::size_t first_frame,
+                                            std::size_t frames_per_step) {
+        // every step presses its keys again: a key that FX0A released while it was held is pressed
+        // again by the next step of the search as well
+        std::vector<batch::InputEvent> events;
+        uint16_t held = 0;
+        for (std::size_t idx = 0; idx <= path.size(); idx++) {
+            const auto keys = idx < path.size() ? path[idx] : uint16_t{0};
+            const auto frame = first_frame + idx * frames_per_step;
+            for (uint8_t key = 0; key < 16; key++) {
+                const auto pressed = ((keys >> key) & 1U) != 0;
+                if (pressed || ((held >> key) & 1U) != 0) { events.push_back({frame, key, pressed}); }
+            }
+            held = keys;
+        }
+        return events;
+    }
+
+} // namespace chip8::search
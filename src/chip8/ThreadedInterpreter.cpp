@@ -0,0 +1,250 @@
+#include "chip8/Chip8.h"
+
+#include <functional>
+
+#include <gsl/narrow>
+
+#include "chip8/InstructionPartAccessorFunctions.h"
+
+// Threaded-code backend: the whole frame is executed inside run_threaded, every handler jumps
+// directly to the handler of the next instruction (labels as values, a GCC/Clang extension).
+// V, I and PC live in locals and are written back to the Chip8 object at the end of the frame
+// and around operations that are delegated to the member functions (draw, random, errors).
+#if defined(__GNUC__)
+#define CHIP8_THREADED_DISPATCH
+#endif
+
+namespace chip8 {
+
+    static constexpr auto F = int{0xF};
+    static constexpr auto sprite_size = int{5};
+
+    // same as Chip8::incPC: make sure PC never points to a location bigger than the memory
+    static constexpr uint16_t next_pc(uint16_t pc) {
+        return gsl::narrow_cast<uint16_t>(std::min(pc + 2, Chip8::mem_size - 2));
+    }
+
+#ifdef CHIP8_THREADED_DISPATCH
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+    // NOLINTBEGIN (cppcoreguidelines-avoid-goto, cppcoreguidelines-macro-usage, cppcoreguidelines-pro-bounds-constant-array-index)
+    void Chip8::run_threaded(int cycles) {
+        // handlers in the same order as Chip8::operations, the last one handles invalid opcodes
+        static const std::array<void *, num_opcodes + 1> handlers{
+                &&clear_screen, &&return_from_subroutine,
+                &&goto_nnn, &&call_subroutine,
+                &&skip_ifeq_vx_nn, &&skip_ifneq_vx_nn,
+                &&skip_ifeq_xy, &&ld_vx_nn,
+                &&add_vx_nn, &&ld_vx_vy,
+                &&or_vx_vy, &&and_vx_vy, &&xor_vx_vy,
+                &&add_vx_vy, &&sub_vx_vy, &&rshift,
+                &&sub_vx_vy_minus_vx, &&lshift,
+                &&skip_ifneq_xy, &&ld_i_nnn,
+                &&goto_nnn_plus_v0, &&and_rand,
+                &&draw, &&skip_if_key_vx_pressed,
+                &&skip_if_key_vx_not_pressed, &&ld_vx_delay_timer,
+                &&get_key_pressed, &&ld_delay_timer_vx,
+                &&ld_sound_timer_vx, &&add_to_I,
+                &&set_I_to_digit_sprite_address, &&vx_to_BCD,
+                &&regdump, &&regload,
+                &&fault,
+        };
+
+        auto v = V;
+        auto pc = PC;
+        auto i = I;
+        auto remaining = cycles;
+        uint16_t opcode = 0;
+        uint16_t address = 0;
+
+#define SYNC_OUT() V = v; I = i; PC = pc
+#define SYNC_IN() v = V; i = I
+#define DISPATCH()                                                                           \
+        if (remaining <= 0) { goto done; }                                                   \
+        remaining--;                                                                         \
+        address = pc;                                                                        \
+        opcode = gsl::narrow_cast<uint16_t>((memory[pc] << 8) | memory[(pc + 1) & address_mask]); \
+        pc = next_pc(pc);                                                                    \
+        goto *handlers[op_index_table[opcode]]
+
+        DISPATCH();
+
+    clear_screen:
+        op_clear_screen(opcode);
+        DISPATCH();
+    return_from_subroutine:
+        if (stack_pointer == 0) { goto fault; }
+        pc = stack[--stack_pointer];
+        DISPATCH();
+    goto_nnn:
+        pc = nnn(opcode);
+        DISPATCH();
+    call_subroutine:
+        if (stack_pointer == stack_depth) { goto fault; }
+        stack[stack_pointer++] = pc;
+        pc = nnn(opcode);
+        DISPATCH();
+    skip_ifeq_vx_nn:
+        if (v[X(opcode)] == nn(opcode)) { pc = next_pc(pc); }
+        DISPATCH();
+    skip_ifneq_vx_nn:
+        if (v[X(opcode)] != nn(opcode)) { pc = next_pc(pc); }
+        DISPATCH();
+    skip_ifeq_xy:
+        if (v[X(opcode)] == v[Y(opcode)]) { pc = next_pc(pc); }
+        DISPATCH();
+    ld_vx_nn:
+        v[X(opcode)] = nn(opcode);
+        DISPATCH();
+    add_vx_nn:
+        v[X(opcode)] += nn(opcode);
+        DISPATCH();
+    ld_vx_vy:
+        v[X(opcode)] = v[Y(opcode)];
+        DISPATCH();
+    or_vx_vy:
+        v[X(opcode)] |= v[Y(opcode)];
+        DISPATCH();
+    and_vx_vy:
+        v[X(opcode)] &= v[Y(opcode)];
+        DISPATCH();
+    xor_vx_vy:
+        v[X(opcode)] ^= v[Y(opcode)];
+        DISPATCH();
+    add_vx_vy: {
+        const auto vx = v[X(opcode)];
+        v[X(opcode)] += v[Y(opcode)];
+        v[F] = vx > v[X(opcode)];
+        DISPATCH();
+    }
+    sub_vx_vy: {
+        const auto vx = v[X(opcode)];
+        v[X(opcode)] -= v[Y(opcode)];
+        v[F] = vx >= v[X(opcode)];
+        DISPATCH();
+    }
+    rshift: {
+        const auto y = shift_implementation_vy ? Y(opcode) : X(opcode);
+        v[F] = v[y] & 0b1U;
+        v[X(opcode)] = v[y] >> 1U;
+        DISPATCH();
+    }
+    sub_vx_vy_minus_vx: {
+        const auto vy = v[Y(opcode)];
+        v[X(opcode)] = v[Y(opcode)] - v[X(opcode)];
+        v[F] = vy >= v[X(opcode)];
+        DISPATCH();
+    }
+    lshift: {
+        const auto y = shift_implementation_vy ? Y(opcode) : X(opcode);
+        v[F] = v[y] >> 7;
+        v[X(opcode)] = gsl::narrow_cast<uint8_t>((v[y] << 1U) & 0xFF);
+        DISPATCH();
+    }
+    skip_ifneq_xy:
+        if (v[X(opcode)] != v[Y(opcode)]) { pc = next_pc(pc); }
+        DISPATCH();
+    ld_i_nnn:
+        i = nnn(opcode);
+        DISPATCH();
+    goto_nnn_plus_v0:
+        pc = (nnn(opcode) + v[0]) & address_mask;
+        DISPATCH();
+    and_rand:
+        SYNC_OUT();
+        op_and_rand(opcode);
+        SYNC_IN();
+        DISPATCH();
+    draw:
+        SYNC_OUT();
+        op_draw(opcode);
+        SYNC_IN();
+        DISPATCH();
+    skip_if_key_vx_pressed:
+        if (keys[get4Bit(v[X(opcode)], 0)]) { pc = next_pc(pc); }
+        DISPATCH();
+    skip_if_key_vx_not_pressed:
+        if (!keys[get4Bit(v[X(opcode)], 0)]) { pc = next_pc(pc); }
+        DISPATCH();
+    ld_vx_delay_timer:
+        v[X(opcode)] = delay_timer;
+        DISPATCH();
+    get_key_pressed: {
+        for (std::size_t key_idx = 0; key_idx < keys.size(); key_idx++) {
+            if (keys[key_idx]) {
+                v[X(opcode)] = static_cast<uint8_t>(key_idx);
+                keys[key_idx] = false;
+                DISPATCH();
+            }
+        }
+        // No key can be pressed before the end of the frame: the interpreter would execute
+        // this instruction for every remaining cycle, only the tick count changes.
+        pc -= 2;
+        remaining = 0;
+        goto done;
+    }
+    ld_delay_timer_vx:
+        delay_timer = v[X(opcode)];
+        DISPATCH();
+    ld_sound_timer_vx:
+        sound_timer = v[X(opcode)];
+        DISPATCH();
+    add_to_I:
+        i += v[X(opcode)];
+        DISPATCH();
+    set_I_to_digit_sprite_address:
+        i = sprite_size * get4Bit(v[X(opcode)], 0);
+        DISPATCH();
+    vx_to_BCD: {
+        const auto vx = v[X(opcode)];
+        memory[i & address_mask] = vx / 100;
+        memory[(i + 1) & address_mask] = (vx % 100) / 10;
+        memory[(i + 2) & address_mask] = vx % 10;
+        invalidate_decoded(i & address_mask, 3);
+        DISPATCH();
+    }
+    regdump: {
+        const uint16_t x = X(opcode) + 1;
+        for (uint16_t k = 0; k < x; k++) { memory[(i + k) & address_mask] = v[k]; }
+        invalidate_decoded(i & address_mask, x);
+        i += x;
+        DISPATCH();
+    }
+    regload: {
+        const uint16_t x = X(opcode) + 1;
+        for (uint16_t k = 0; k < x; k++) { v[k] = memory[(i + k) & address_mask]; }
+        i += x;
+        DISPATCH();
+    }
+    fault:
+        // invalid opcodes and stack errors are raised by the member operation, the faulting
+        // instruction itself is not counted, like in exec_op_cycle
+        tick_count += static_cast<std::size_t>(cycles - remaining - 1);
+        SYNC_OUT();
+        std::invoke(fetch_op(opcode), this, opcode);
+        stop_on_fault(address);
+        return;
+
+    done:
+        tick_count += static_cast<std::size_t>(cycles - remaining);
+        SYNC_OUT();
+
+#undef DISPATCH
+#undef SYNC_IN
+#undef SYNC_OUT
+    }
+    // NOLINTEND
+
+#pragma GCC diagnostic pop
+
+#else
+
+    void Chip8::run_threaded(int cycles) {
+        run_interpreter(cycles);
+    }
+
+#endif
+
+} // namespace chip8
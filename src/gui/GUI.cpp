@@ -41,8 +41,8 @@ bool CallBackCheckbox(const char *label, bool *v, auto func) {
 }
 
 
-GUI::GUI(GLFWwindow *window, chip8::Chip8 &t_chip8)
-        : window_(window), chip8(t_chip8) {
+GUI::GUI(GLFWwindow *window, chip8::EmulationThread &t_emulation)
+        : window_(window), emulation(t_emulation), instructions_per_second(emulation.snapshot().instructions_per_second) {
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
 
@@ -191,7 +191,7 @@ void GUI::display_chip8_screen(uint32_t texture) const {
 
 
 void GUI::display_menubar() {
-    const auto state = chip8.get_state();
+    const auto state = emulation.snapshot().state;
 
     ImGui::BeginMenuBar();
     {
@@ -202,11 +202,11 @@ void GUI::display_menubar() {
         }
         if (ImGui::BeginMenu("Chip8")) {
             ImGui::BeginDisabled(state == State::Empty);
-            if (ImGui::MenuItem(state_to_action_name(state), "Space")) { chip8.toggle_pause(); }
+            if (ImGui::MenuItem(state_to_action_name(state), "Space")) { emulation.send(chip8::command::TogglePause{}); }
             ImGui::EndDisabled();
 
-            ImGui::BeginDisabled(chip8.get_state() == State::Empty);
-            if (ImGui::MenuItem("Reset ROM", "Ctrl+R")) { chip8.reset_rom(); }//chip8.load_rom_from_file(game_path); }
+            ImGui::BeginDisabled(state == State::Empty);
+            if (ImGui::MenuItem("Reset ROM", "Ctrl+R")) { emulation.send(chip8::command::ResetRom{}); }
             ImGui::EndDisabled();
             ImGui::EndMenu();
 
@@ -235,7 +235,7 @@ void GUI::display_file_dialog() {
         glfwSetWindowTitle(window_, title.c_str());
         // load game
         game_path = file_dialog.GetSelected().string();
-        chip8.load_rom_from_file(game_path);
+        emulation.send(chip8::command::LoadRom{game_path});
         auto readme_file = file_dialog.GetSelected().replace_extension(".txt").string();
         load_rom_readme(readme_file);
 
@@ -247,18 +247,32 @@ void GUI::display_file_dialog() {
 void GUI::display_settings_window() {
     ImGui::Begin("Settings", &show_settings_window); // , nullptr, ImGuiWindowFlags_NoMove);
 
-    ImGui::Text("Number of instruction cycles per frame:");
-    static constexpr auto max_cycles_per_frame = 500;
-    ImGui::SliderInt("cycles/frame:", &chip8.cycles_per_frame, 1, max_cycles_per_frame);
+    ImGui::Text("Number of instructions per second:");
+    static constexpr auto max_instructions_per_second = 30000;
+    if (ImGui::SliderInt("instructions/s:", &instructions_per_second, chip8::EmulationClock::timer_frequency,
+                         max_instructions_per_second, "%d", ImGuiSliderFlags_Logarithmic)) {
+        emulation.send(chip8::command::SetInstructionsPerSecond{instructions_per_second});
+    }
 
     ImGui::Checkbox("Chip8-Display: Fixed Aspect Ratio", &fixed_aspect_ratio);
 
     CallBackCheckbox(
         "Shift operations: shift value of register Vy",
         &shift_implementation_vy,
-        [this] (bool v) { this->chip8.set_shift_implementation(v);  }
+        [this] (bool v) { emulation.send(chip8::command::SetShiftImplementation{v}); }
     );
 
+    static constexpr std::array backend_names{"Interpreter", "Threaded", "JIT (x86-64)", "Recompiled ROM"};
+    if (ImGui::Combo("Backend", &backend, backend_names.data(), static_cast<int>(backend_names.size()))) {
+        emulation.send(chip8::command::SetBackend{static_cast<chip8::Backend>(backend)});
+    }
+
+    // shows frames ahead to hide the input lag of the ROM, measure with chip8_headless --run-ahead
+    if (ImGui::SliderInt("Run-ahead frames", &run_ahead_frames, 0, chip8::RunAhead::max_frames)) {
+        emulation.send(chip8::command::SetRunAhead{run_ahead_frames});
+    }
+    ImGui::Text("Run-ahead: %.1f us per frame", emulation.snapshot().run_ahead_nanoseconds / 1000.0); // NOLINT no magic number
+
     ImGui::Separator(); ImGui::Separator();
 
 
@@ -274,48 +288,91 @@ void GUI::display_settings_window() {
 
 void GUI::display_control_window() {
     ImGui::Begin("call stack", &show_control_window);
-    const auto state = chip8.get_state();
+    const auto &snapshot = emulation.snapshot();
+    const auto state = snapshot.state;
 
     ImGui::BeginDisabled(state != State::Paused && state != State::Reset);
-    if (ImGui::Button("Execute instruction")) { chip8.exec_op_cycle(); }
+    if (ImGui::Button("Execute instruction")) { emulation.send(chip8::command::ExecuteInstruction{}); }
+    ImGui::EndDisabled();
+
+    // jumps to any tick of the playing movie, from the nearest checkpoint before it
+    ImGui::SameLine();
+    ImGui::BeginDisabled(!snapshot.movie_loaded);
+    static constexpr float tick_input_width = 100.0F;
+    ImGui::SetNextItemWidth(tick_input_width);
+    ImGui::InputScalar("##seek tick", ImGuiDataType_U64, &seek_tick);
+    ImGui::SameLine();
+    if (ImGui::Button("Seek to tick")) { emulation.send(chip8::command::SeekTick{gsl::narrow_cast<std::size_t>(seek_tick)}); }
     ImGui::EndDisabled();
 
     ImGui::SameLine();
 
     ImGui::BeginDisabled(state == State::Empty);
-    if (ImGui::Button(state_to_action_name(state))) { chip8.toggle_pause(); }
+    if (ImGui::Button(state_to_action_name(state))) { emulation.send(chip8::command::TogglePause{}); }
+    ImGui::SameLine();
+    // rewinds one frame per frame while the button is held down, like the backspace key
+    ImGui::Button("Hold to rewind");
     ImGui::EndDisabled();
+    if (const auto held = ImGui::IsItemActive(); held != rewind_held) {
+        rewind_held = held;
+        emulation.send(chip8::command::SetRewinding{held});
+    }
 
-    ImGui::Text("Tick count: %zu", chip8.get_tick_count());
+    // movies are written next to the ROM, replay them with chip8_headless --replay
+    ImGui::BeginDisabled(game_path.empty());
+    if (snapshot.recording) {
+        if (ImGui::Button("Stop recording")) { emulation.send(chip8::command::StopRecording{}); }
+    } else if (ImGui::Button("Record movie")) {
+        emulation.send(chip8::command::StartRecording{game_path + ".c8mv"});
+    }
+    ImGui::SameLine();
+    if (snapshot.movie_loaded) {
+        if (ImGui::Button("Stop movie")) { emulation.send(chip8::command::StopMovie{}); }
+    } else if (ImGui::Button("Play movie")) {
+        emulation.send(chip8::command::PlayMovie{game_path + ".c8mv"});
+    }
+    ImGui::EndDisabled();
+
+    if (snapshot.movie_loaded) {
+        ImGui::Text("Tick count: %zu of %zu in the movie", snapshot.tick_count, snapshot.movie_end_tick);
+    } else {
+        ImGui::Text("Tick count: %zu", snapshot.tick_count);
+    }
+    static constexpr double frames_per_second = 60.0;
+    static constexpr double kibibyte = 1024.0;
+    const auto &rewind = snapshot.rewind;
+    ImGui::Text("Rewind: %.1f s in %.0f KiB (%.0f KiB per minute)%s", static_cast<double>(rewind.frames) / frames_per_second,
+                static_cast<double>(rewind.bytes) / kibibyte, rewind.bytes_per_minute() / kibibyte,
+                snapshot.rewinding ? ", rewinding" : "");
+    ImGui::Text("%zu keyframes, capture %.0f ns per frame", rewind.keyframes, rewind.capture_nanoseconds);
     ImGui::Separator();
 
-    const auto pc = chip8.get_pc();
+    const auto pc = snapshot.pc;
     ImGui::BeginChild("stack", ImVec2(ImGui::GetContentRegionAvail().x * 0.5F, 0), true); // NOLINT no magic number
-    const uint16_t op = gsl::narrow_cast<uint16_t>(chip8.get_memory()[pc] << 8) | chip8.get_memory()[pc + 1]; // NOLINT signed because of int promotion
+    const uint16_t op = gsl::narrow_cast<uint16_t>(snapshot.memory[pc] << 8) | snapshot.memory[(pc + 1) & chip8::Chip8::address_mask]; // NOLINT signed because of int promotion
     auto op_text = chip8::opcode_to_assembler(op);
     ImGui::Text("%04X \t %s", op, op_text.data());
 
     ImGui::Separator();
 
-    auto call_stack = chip8.get_call_stack();
-    for (const auto opcode: call_stack) {
+    for (const auto &[address, opcode]: snapshot.history) {
         auto assembler = chip8::opcode_to_assembler(opcode);
-        ImGui::Text("%04X \t %s", opcode, assembler.data());
+        ImGui::Text("%03X: %04X \t %s", address, opcode, assembler.data());
     }
     ImGui::EndChild();
     ImGui::SameLine();
     ImGui::BeginChild("registers", ImVec2(0, 0), true);
     ImGui::Text("PC: 0x%2X (%d)", pc, pc);
+    ImGui::Text("SP: %zu", snapshot.stack_pointer);
     ImGui::Separator();
-    const auto I = chip8.get_i();
+    const auto I = snapshot.i;
     ImGui::Text("I: %X (%d)", I, I);
 
-    auto registers = chip8.get_registers();
-    for (int n = 0; const auto reg: registers) {
+    for (int n = 0; const auto reg: snapshot.registers) {
         ImGui::Text("V%X = 0x%02X", n++, reg);
     }
-    ImGui::Text("DelayTimer: %d", chip8.get_delay_timer());
-    ImGui::Text("Sound Timer: %d", chip8.get_sound_timer());
+    ImGui::Text("DelayTimer: %d", snapshot.delay_timer);
+    ImGui::Text("Sound Timer: %d", snapshot.sound_timer);
     ImGui::EndChild();
 
     ImGui::End();
@@ -339,7 +396,8 @@ static void MemText(const uint16_t word) {
 }
 
 void GUI::display_memory_map() {
-    const auto &mem = chip8.get_memory();
+    const auto &snapshot = emulation.snapshot();
+    const auto &mem = snapshot.memory;
     static constexpr auto words_per_row = 8;
     static constexpr auto rows = chip8::Chip8::mem_size / 16;
 
@@ -371,7 +429,7 @@ void GUI::display_memory_map() {
                 const auto word = gsl::narrow<uint16_t>((byte1 << 8U) | byte2); // NOLINT
                 ImGui::TableNextColumn();
                 MemText(word);
-                if (idx == chip8.get_pc()) {
+                if (idx == snapshot.pc) {
                     const ImU32 cell_bg_color = ImGui::GetColorU32(ImVec4(0.3F, 0.3F, 0.7F, 0.65F));
                     ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, cell_bg_color);
                 }
@@ -0,0 +1,301 @@
+// chip8_headless - run a Chip8 ROM without window, as fast as possible.
+//
+// usage: chip8_headless <rom.ch8> [options]
+//
+//   --frames N             run N frames (default 600, 10 seconds of emulated time)
+//   --instructions N       run until N instructions were executed, instead of --frames
+//   --cycles-per-frame N   instructions per 60 Hz frame (default 8)
+//   --backend NAME         interpreter, threaded, jit or aot
+//   --shift-vx             shift operations shift Vx instead of Vy
+//   --stack-depth N        nested subroutine calls before a stack overflow (default 16)
+//   --seed N               seed of the random number generator
+//   --no-idle-skipping     execute idle loops instead of skipping them
+//   --dump-state           print the final registers, timers and state hash
+//   --frame-hashes FILE    write the hash of the display after every frame, - for stdout
+//   --screenshot FILE      write the final display as PBM image, as RGBA PAM image if FILE
+//                          ends in .pam
+//   --record FILE          record the run as movie
+//   --replay FILE          replay a movie instead of running frames; seed, quirks, frames and
+//                          keys come from the movie, fails if the replay does not end in the
+//                          recorded state
+//   --run-ahead N          run N frames ahead after every frame like the GUI does and report
+//                          the time it takes, to pick N for the ROM
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include "chip8/Chip8.h"
+#include "chip8/Movie.h"
+#include "chip8/RunAhead.h"
+#include "utilities/Hash.h"
+
+namespace {
+
+    struct Options {
+        std::string rom;
+        std::optional<std::size_t> frames;
+        std::optional<std::size_t> instructions;
+        int cycles_per_frame = 8;
+        chip8::Backend backend = chip8::Backend::Interpreter;
+        bool shift_vy = true;
+        std::size_t stack_depth = chip8::Chip8::default_stack_depth;
+        std::optional<uint64_t> seed;
+        bool idle_skipping = true;
+        bool dump_state = false;
+        std::string frame_hashes;
+        std::string screenshot;
+        std::string record;
+        std::string replay;
+        int run_ahead = 0;
+    };
+
+    constexpr std::size_t default_frames = 600;
+
+    std::optional<Options> parse_options(const std::vector<std::string> &args) {
+        if (args.size() < 2) { return std::nullopt; }
+        Options options;
+        options.rom = args[1];
+        for (std::size_t idx = 2; idx < args.size(); idx++) {
+            const auto &arg = args[idx];
+            // options with a value
+            if (arg == "--frames" || arg == "--instructions" || arg == "--cycles-per-frame" || arg == "--backend" ||
+                arg == "--stack-depth" || arg == "--seed" || arg == "--frame-hashes" || arg == "--screenshot" ||
+                arg == "--record" || arg == "--replay" || arg == "--run-ahead") {
+                if (++idx == args.size()) {
+                    spdlog::error("Missing value for {}", arg);
+                    return std::nullopt;
+                }
+                const auto &value = args[idx];
+                try {
+                    if (arg == "--frames") {
+                        options.frames = std::stoull(value);
+                    } else if (arg == "--instructions") {
+                        options.instructions = std::stoull(value);
+                    } else if (arg == "--cycles-per-frame") {
+                        options.cycles_per_frame = std::stoi(value);
+                    } else if (arg == "--stack-depth") {
+                        options.stack_depth = std::stoull(value);
+                    } else if (arg == "--seed") {
+                        options.seed = std::stoull(value, nullptr, 0);
+                    } else if (arg == "--frame-hashes") {
+                        options.frame_hashes = value;
+                    } else if (arg == "--screenshot") {
+                        options.screenshot = value;
+                    } else if (arg == "--record") {
+                        options.record = value;
+                    } else if (arg == "--replay") {
+                        options.replay = value;
+                    } else if (arg == "--run-ahead") {
+                        options.run_ahead = std::stoi(value);
+                    } else if (const auto backend = chip8::parse_backend(value)) {
+                        options.backend = *backend;
+                    } else {
+                        spdlog::error("Unknown backend: {}", value);
+                        return std::nullopt;
+                    }
+                } catch (const std::logic_error &) {
+                    spdlog::error("Invalid value for {}: {}", arg, value);
+                    return std::nullopt;
+                }
+            } else if (arg == "--shift-vx") {
+                options.shift_vy = false;
+            } else if (arg == "--no-idle-skipping") {
+                options.idle_skipping = false;
+            } else if (arg == "--dump-state") {
+                options.dump_state = true;
+            } else {
+                spdlog::error("Unknown option: {}", arg);
+                return std::nullopt;
+            }
+        }
+        if (options.cycles_per_frame < 1) {
+            spdlog::error("--cycles-per-frame has to be at least 1");
+            return std::nullopt;
+        }
+        if (options.run_ahead < 0 || options.run_ahead > chip8::RunAhead::max_frames) {
+            spdlog::error("--run-ahead has to be between 0 and {}", chip8::RunAhead::max_frames);
+            return std::nullopt;
+        }
+        if (!options.frames && !options.instructions) { options.frames = default_frames; }
+        if (!options.record.empty() && !options.replay.empty()) {
+            spdlog::error("--record and --replay cannot be combined");
+            return std::nullopt;
+        }
+        return options;
+    }
+
+    void dump_state(const chip8::Chip8 &chip8) {
+        fmt::print("PC: {:03X}  I: {:03X}  SP: {}\n", chip8.get_pc(), chip8.get_i(), chip8.get_stack_pointer());
+        for (std::size_t idx = 0; idx < chip8.get_registers().size(); idx++) {
+            fmt::print("V{:X}: {:02X}{}", idx, chip8.get_registers()[idx], idx % 8 == 7 ? "\n" : "  ");
+        }
+        fmt::print("DT: {}  ST: {}\n", chip8.get_delay_timer(), chip8.get_sound_timer());
+        const auto &fault = chip8.get_fault();
+        if (fault.fault != chip8::Fault::None) {
+            fmt::print("fault: {} at {:03X} ({:04X})\n", chip8::fault_name(fault.fault), fault.pc, fault.opcode);
+        }
+        fmt::print("state hash: {:016X}\n", chip8.state_hash());
+    }
+
+    // portable arbitrary map with the colors of the GUI, white pixels on black
+    bool write_rgba_screenshot(const chip8::Chip8 &chip8, const std::string &filename) {
+        std::array<uint8_t, 4 * chip8::Chip8::screen_size> pixels{};
+        chip8.get_screen_rgba(pixels);
+        std::ofstream image(filename, std::ios::binary);
+        image << fmt::format("P7\nWIDTH {}\nHEIGHT {}\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n",
+                             chip8::Chip8::screen_width, chip8::Chip8::screen_height);
+        image.write(reinterpret_cast<const char *>(pixels.data()), static_cast<std::streamsize>(pixels.size())); // NOLINT byte buffer
+        return static_cast<bool>(image);
+    }
+
+    // binary portable bitmap, 1 is black: set pixels are written as 0
+    bool write_screenshot(const chip8::Chip8 &chip8, const std::string &filename) {
+        if (filename.ends_with(".pam")) { return write_rgba_screenshot(chip8, filename); }
+        std::ofstream image(filename, std::ios::binary);
+        image << fmt::format("P4\n{} {}\n", chip8::Chip8::screen_width, chip8::Chip8::screen_height);
+        for (auto byte: chip8.get_display_buffer()) {
+            image.put(static_cast<char>(~byte));
+        }
+        return static_cast<bool>(image);
+    }
+
+} // namespace
+
+
+int main(int argc, char **argv) {
+    const std::vector<std::string> args(argv, argv + argc);
+    const auto options = parse_options(args);
+    if (!options) {
+        spdlog::error("usage: chip8_headless <rom.ch8> [--frames N | --instructions N] [--cycles-per-frame N] "
+                      "[--backend interpreter|threaded|jit|aot] [--shift-vx] [--stack-depth N] [--seed N] "
+                      "[--no-idle-skipping] [--dump-state] [--frame-hashes FILE] [--screenshot FILE] "
+                      "[--record FILE | --replay FILE] [--run-ahead N]");
+        return 1;
+    }
+
+    std::ifstream rom_file(options->rom, std::ios::binary);
+    if (!rom_file) {
+        spdlog::error("Could not open file: {}", options->rom);
+        return 1;
+    }
+    rom_file >> std::noskipws;
+    const std::vector<uint8_t> rom((std::istream_iterator<uint8_t>(rom_file)), std::istream_iterator<uint8_t>());
+    if (rom.size() > chip8::Chip8::mem_size - chip8::Chip8::pc_start_address) {
+        spdlog::error("ROM too big: {} bytes", rom.size());
+        return 1;
+    }
+
+    chip8::Chip8 chip8;
+    if (options->seed) { chip8.set_seed(*options->seed); }
+    chip8.set_backend(options->backend);
+    chip8.set_shift_implementation(options->shift_vy);
+    chip8.set_stack_depth(options->stack_depth);
+    chip8.set_idle_skipping(options->idle_skipping);
+    chip8.cycles_per_frame = options->cycles_per_frame;
+    chip8.load_rom(rom);
+    chip8.toggle_pause();
+
+    std::optional<chip8::MoviePlayer> player;
+    if (!options->replay.empty()) {
+        std::ifstream movie_file(options->replay, std::ios::binary);
+        if (!movie_file) {
+            spdlog::error("Could not open file: {}", options->replay);
+            return 1;
+        }
+        auto movie = chip8::Movie::read(movie_file);
+        if (!movie) { return 1; }
+        player.emplace(std::move(*movie));
+        if (!player->start(chip8)) { return 1; }
+    }
+    std::optional<chip8::MovieRecorder> recorder;
+    if (!options->record.empty()) { recorder.emplace(chip8); }
+
+    if (options->backend == chip8::Backend::Aot && !chip8.has_recompiled_rom()) {
+        spdlog::warn("No recompiled version of the ROM is linked, the ROM is interpreted");
+    }
+
+    std::FILE *hashes = nullptr;
+    if (options->frame_hashes == "-") {
+        hashes = stdout;
+    } else if (!options->frame_hashes.empty()) {
+        hashes = std::fopen(options->frame_hashes.c_str(), "w"); // NOLINT owning raw pointer, closed below
+        if (hashes == nullptr) {
+            spdlog::error("Could not write file: {}", options->frame_hashes);
+            return 1;
+        }
+    }
+
+    chip8::RunAhead run_ahead(options->run_ahead);
+    const auto display_consumer = chip8.add_display_consumer();
+    chip8::Chip8::DisplayRows ahead_rows{};
+    chip8::Chip8::DirtyRows ahead_dirty = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    std::size_t frame = 0;
+    while (chip8.get_state() == chip8::State::Running) {
+        if (player) {
+            if (player->finished()) { break; }
+            player->play_frame(chip8);
+        } else {
+            if (options->frames && frame == *options->frames) { break; }
+            auto instructions = chip8.cycles_per_frame;
+            if (options->instructions) {
+                const auto left = *options->instructions - chip8.get_tick_count();
+                if (left == 0) { break; }
+                instructions = static_cast<int>(std::min<std::size_t>(left, static_cast<std::size_t>(instructions)));
+            }
+            if (recorder) { recorder->record_frame(chip8, 0, instructions); }
+            chip8.tick(instructions);
+            run_ahead.run(chip8, instructions, display_consumer, ahead_rows, ahead_dirty);
+        }
+        if (hashes != nullptr) {
+            fmt::print(hashes, "{} {:016X}\n", frame, fnv1a(chip8.get_display_buffer()));
+        }
+        frame++;
+    }
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (hashes != nullptr && hashes != stdout) { std::fclose(hashes); } // NOLINT see fopen
+
+    const auto instructions = chip8.get_tick_count();
+    spdlog::info("{} frames, {} instructions in {:.3f} s with the {} backend: {:.0f} instructions/s", frame,
+                 instructions, seconds, chip8::backend_name(options->backend),
+                 seconds > 0 ? static_cast<double>(instructions) / seconds : 0.0);
+    if (chip8.get_fault().fault != chip8::Fault::None) {
+        spdlog::warn("Program stopped by a fault after {} frames", frame);
+    }
+    if (run_ahead.get_frames() != 0) {
+        spdlog::info("Run-ahead of {} frames: {:.1f} us per frame", run_ahead.get_frames(),
+                     run_ahead.get_nanoseconds() / 1000.0); // NOLINT no magic number
+    }
+
+    if (recorder) {
+        std::ofstream movie_file(options->record, std::ios::binary);
+        if (!recorder->finish(chip8).write(movie_file)) {
+            spdlog::error("Could not write file: {}", options->record);
+            return 1;
+        }
+    }
+
+    if (options->dump_state) { dump_state(chip8); }
+    if (!options->screenshot.empty() && !write_screenshot(chip8, options->screenshot)) {
+        spdlog::error("Could not write file: {}", options->screenshot);
+        return 1;
+    }
+    if (player && !player->matches(chip8)) {
+        spdlog::error("Replay diverged: ended after {} instructions with state hash {:016X}, recorded {} instructions "
+                      "and {:016X}", chip8.get_tick_count(), chip8.state_hash(), player->get_movie().end_tick,
+                      player->get_movie().end_state_hash);
+        return 3;
+    }
+    return chip8.get_fault().fault == chip8::Fault::None ? 0 : 2;
+}
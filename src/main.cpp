@@ -7,8 +7,10 @@
 
 #include "utilities/Shader.h"
 #include "utilities/Canvas.h"
-#include "utilities/SimpleDisplayTexture.h"
+#include "utilities/FrameBuffer.h"
+#include "utilities/PackedDisplayTexture.h"
 #include "chip8/Chip8.h"
+#include "chip8/EmulationThread.h"
 #include "chip8/MazeDemo.h"
 
 GLFWwindow *createWindow(int width, int height);
@@ -19,11 +21,16 @@ static void glfw_error_callback(int error, const char *description) {
 
 static void
 key_callback(GLFWwindow *window, int key, int, int action, int mods) { // NOLINT unnamed parameter is not used
-    auto *chip8 = static_cast<chip8::Chip8 *>(glfwGetWindowUserPointer(window));
+    auto *emulation = static_cast<chip8::EmulationThread *>(glfwGetWindowUserPointer(window));
     if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
-        chip8->toggle_pause();
+        emulation->send(chip8::command::TogglePause{});
     }
     if (key == GLFW_KEY_R && action == GLFW_PRESS && mods == GLFW_MOD_CONTROL) {
+        emulation->send(chip8::command::ResetRom{});
+    }
+    // hold backspace to rewind
+    if (key == GLFW_KEY_BACKSPACE && action != GLFW_REPEAT) {
+        emulation->send(chip8::command::SetRewinding{action == GLFW_PRESS});
     }
 
     static constexpr std::array keybindings{
@@ -38,9 +45,9 @@ key_callback(GLFWwindow *window, int key, int, int action, int mods) { // NOLINT
     for (std::size_t keyn = 0; keyn < keybindings.size(); keyn++) {
         if (key == keybindings[keyn]) {
             if (action == GLFW_PRESS) {
-                chip8->keys[keyn] = true;
+                emulation->set_key(keyn, true);
             } else if (action == GLFW_RELEASE) {
-                chip8->keys[keyn] = false;
+                emulation->set_key(keyn, false);
             }
         }
     }
@@ -67,14 +74,16 @@ int main() {
     chip8.load_rom(maze_data);
 
     const auto canvas = Canvas{};
-    SimpleDisplayTexture display_texture;
+    PackedDisplayTexture display_texture;
     FrameBuffer frame_buffer(width, height);
     Shader shader("res/shaders/vertexShader.glsl", "res/shaders/fragmentShader.glsl");
 
     {
-        GUI imgui(window, chip8);
+        // from here on the chip8 is only used by the emulation thread
+        chip8::EmulationThread emulation(chip8);
+        GUI imgui(window, emulation);
 
-        glfwSetWindowUserPointer(window, static_cast<void *>(&chip8));
+        glfwSetWindowUserPointer(window, static_cast<void *>(&emulation));
         glfwSetKeyCallback(window, key_callback);
 
         // Main loop
@@ -82,10 +91,9 @@ int main() {
             // Poll and handle events (inputs, window_ resize, etc.)
             glfwPollEvents();
 
-            chip8.tick();
-            if (chip8.draw_flag) {
-                display_texture.load_texture(chip8);
-                chip8.draw_flag = false;
+            // never blocks, the emulation keeps its own pace
+            if (emulation.update_snapshot()) {
+                display_texture.load_texture(emulation.snapshot());
             }
 
             glClearColor(0.0F, 0.0F, 0.0F, 1.0F); // NOLINT color
@@ -0,0 +1,265 @@
+// chip8_search - find the shortest key sequence that brings a ROM to a goal, on all cores.
+//
+// usage: chip8_search <rom.ch8> <goal>... [options]
+//
+// goals, all of them have to hold:
+//   --goal-memory ADDR=VALUE   the byte at ADDR is VALUE, both may be hexadecimal with 0x
+//   --goal-pixel X,Y           the pixel at X,Y is set
+//   --goal-screen FILE         the display equals a PBM image as written by chip8_headless --screenshot
+//
+// options:
+//   --start-frames N           frames run without keys before the search starts (default 0)
+//   --frames-per-step N        frames the keys of a decision are held (default 1)
+//   --max-steps N              longest path searched (default 120)
+//   --max-states N             distinct states the search may visit (default 100000)
+//   --threads N                worker threads (default: all cores)
+//   --cycles-per-frame N, --backend NAME, --shift-vx, --seed N, --no-idle-skipping
+//                              as for chip8_headless
+//   --script FILE              write the path as input script for a chip8_batch job with the same
+//                              settings
+//
+// Prints the keys of every step. Exit code 0 if a path was found, 2 if not.
+
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include "chip8/Chip8.h"
+#include "chip8/Search.h"
+
+namespace {
+
+    // 8 bytes per row, as returned by Chip8::get_display_buffer()
+    using Screen = std::array<uint8_t, chip8::Chip8::screen_height * 8>;
+
+    struct MemoryGoal {
+        std::size_t address = 0;
+        uint8_t value = 0;
+    };
+
+    struct PixelGoal {
+        std::size_t x = 0;
+        std::size_t y = 0;
+    };
+
+    constexpr std::size_t screen_width = chip8::Chip8::screen_width;
+    constexpr std::size_t screen_height = chip8::Chip8::screen_height;
+
+    struct Options {
+        std::string rom;
+        std::vector<MemoryGoal> memory_goals;
+        std::vector<PixelGoal> pixel_goals;
+        std::optional<Screen> screen_goal;
+        std::size_t start_frames = 0;
+        chip8::search::Config config;
+        int cycles_per_frame = 8;
+        bool shift_vy = true;
+        uint64_t seed = 0;
+        std::string script;
+    };
+
+    // binary portable bitmap of the display size, 1 is black: set pixels are stored as 0
+    std::optional<Screen> read_screenshot(const std::string &filename) {
+        std::ifstream image(filename, std::ios::binary);
+        std::string magic;
+        std::size_t width = 0;
+        std::size_t height = 0;
+        if (!(image >> magic >> width >> height) || magic != "P4" || width != screen_width || height != screen_height) {
+            return std::nullopt;
+        }
+        image.get();
+        Screen screen{};
+        for (auto &byte: screen) {
+            const auto data = image.get();
+            if (data == std::ifstream::traits_type::eof()) { return std::nullopt; }
+            byte = static_cast<uint8_t>(~data);
+        }
+        return screen;
+    }
+
+    std::optional<Options> parse_options(const std::vector<std::string> &args) {
+        if (args.size() < 2) { return std::nullopt; }
+        Options options;
+        options.rom = args[1];
+        for (std::size_t idx = 2; idx < args.size(); idx++) {
+            const auto &arg = args[idx];
+            if (arg == "--shift-vx") {
+                options.shift_vy = false;
+                continue;
+            }
+            if (arg == "--no-idle-skipping") {
+                options.config.idle_skipping = false;
+                continue;
+            }
+            if (++idx == args.size()) {
+                spdlog::error("Missing value for {}", arg);
+                return std::nullopt;
+            }
+            const auto &value = args[idx];
+            try {
+                if (arg == "--goal-memory") {
+                    const auto separator = value.find('=');
+                    if (separator == std::string::npos) { throw std::invalid_argument(value); }
+                    const auto address = std::stoull(value.substr(0, separator), nullptr, 0);
+                    const auto byte = std::stoull(value.substr(separator + 1), nullptr, 0);
+                    if (address >= chip8::Chip8::mem_size || byte > 0xFF) { throw std::out_of_range(value); }
+                    options.memory_goals.push_back({address, static_cast<uint8_t>(byte)});
+                } else if (arg == "--goal-pixel") {
+                    const auto separator = value.find(',');
+                    if (separator == std::string::npos) { throw std::invalid_argument(value); }
+                    const auto x = std::stoull(value.substr(0, separator));
+                    const auto y = std::stoull(value.substr(separator + 1));
+                    if (x >= screen_width || y >= screen_height) { throw std::out_of_range(value); }
+                    options.pixel_goals.push_back({x, y});
+                } else if (arg == "--goal-screen") {
+                    options.screen_goal = read_screenshot(value);
+                    if (!options.screen_goal) {
+                        spdlog::error("Could not read a {}x{} PBM image from {}", screen_width, screen_height, value);
+                        return std::nullopt;
+                    }
+                } else if (arg == "--start-frames") {
+                    options.start_frames = std::stoull(value);
+                } else if (arg == "--frames-per-step") {
+                    options.config.frames_per_step = std::stoull(value);
+                } else if (arg == "--max-steps") {
+                    options.config.max_steps = std::stoull(value);
+                } else if (arg == "--max-states") {
+                    options.config.max_states = std::stoull(value);
+                } else if (arg == "--threads") {
+                    options.config.threads = static_cast<unsigned>(std::stoul(value));
+                } else if (arg == "--cycles-per-frame") {
+                    options.cycles_per_frame = std::stoi(value);
+                } else if (arg == "--seed") {
+                    options.seed = std::stoull(value, nullptr, 0);
+                } else if (arg == "--script") {
+                    options.script = value;
+                } else if (arg == "--backend") {
+                    const auto backend = chip8::parse_backend(value);
+                    if (!backend) {
+                        spdlog::error("Unknown backend: {}", value);
+                        return std::nullopt;
+                    }
+                    options.config.backend = *backend;
+                } else {
+                    spdlog::error("Unknown option: {}", arg);
+                    return std::nullopt;
+                }
+            } catch (const std::logic_error &) {
+                spdlog::error("Invalid value for {}: {}", arg, value);
+                return std::nullopt;
+            }
+        }
+        if (options.memory_goals.empty() && options.pixel_goals.empty() && !options.screen_goal) {
+            spdlog::error("No goal given");
+            return std::nullopt;
+        }
+        if (options.cycles_per_frame < 1 || options.config.frames_per_step < 1 || options.config.threads < 1) {
+            spdlog::error("--cycles-per-frame, --frames-per-step and --threads have to be at least 1");
+            return std::nullopt;
+        }
+        return options;
+    }
+
+    std::string keys_to_string(uint16_t keys) {
+        if (keys == 0) { return "-"; }
+        std::string text;
+        for (unsigned key = 0; key < 16; key++) {
+            if (((keys >> key) & 1U) != 0) { text += fmt::format("{:X}", key); }
+        }
+        return text;
+    }
+
+} // namespace
+
+
+int main(int argc, char **argv) {
+    const std::vector<std::string> args(argv, argv + argc);
+    const auto options = parse_options(args);
+    if (!options) {
+        spdlog::error("usage: chip8_search <rom.ch8> [--goal-memory ADDR=VALUE]... [--goal-pixel X,Y]... "
+                      "[--goal-screen FILE] [--start-frames N] [--frames-per-step N] [--max-steps N] "
+                      "[--max-states N] [--threads N] [--cycles-per-frame N] "
+                      "[--backend interpreter|threaded|jit|aot] [--shift-vx] [--seed N] [--no-idle-skipping] "
+                      "[--script FILE]");
+        return 1;
+    }
+
+    std::ifstream rom_file(options->rom, std::ios::binary);
+    if (!rom_file) {
+        spdlog::error("Could not open file: {}", options->rom);
+        return 1;
+    }
+    rom_file >> std::noskipws;
+    const std::vector<uint8_t> rom((std::istream_iterator<uint8_t>(rom_file)), std::istream_iterator<uint8_t>());
+    if (rom.size() > chip8::Chip8::mem_size - chip8::Chip8::pc_start_address) {
+        spdlog::error("ROM too big: {} bytes", rom.size());
+        return 1;
+    }
+
+    chip8::Chip8 chip8;
+    chip8.set_seed(options->seed);
+    chip8.set_backend(options->config.backend);
+    chip8.set_shift_implementation(options->shift_vy);
+    chip8.set_idle_skipping(options->config.idle_skipping);
+    chip8.cycles_per_frame = options->cycles_per_frame;
+    chip8.load_rom(rom);
+    chip8.toggle_pause();
+    for (std::size_t frame = 0; frame < options->start_frames && chip8.get_state() == chip8::State::Running; frame++) {
+        chip8.tick();
+    }
+    if (chip8.get_state() != chip8::State::Running) {
+        spdlog::error("The program stopped before the search started");
+        return 1;
+    }
+
+    const auto goal = [&options](const chip8::Chip8 &state) {
+        const auto &memory = state.get_memory();
+        for (const auto &memory_goal: options->memory_goals) {
+            if (memory[memory_goal.address] != memory_goal.value) { return false; }
+        }
+        if (options->pixel_goals.empty() && !options->screen_goal) { return true; }
+        const auto screen = state.get_display_buffer();
+        for (const auto &pixel: options->pixel_goals) {
+            const auto byte = screen[(pixel.y * screen_width + pixel.x) / 8];
+            if (((byte >> (7 - pixel.x % 8)) & 1U) == 0) { return false; }
+        }
+        return !options->screen_goal || screen == *options->screen_goal;
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto result = chip8::search::find_shortest_path(rom, chip8.save_state(), goal, options->config);
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    spdlog::info("{} distinct states in {} steps, {} frames in {:.3f} s on {} threads: {:.0f} frames/s",
+                 result.states, result.steps, result.frames, seconds, options->config.threads,
+                 seconds > 0 ? static_cast<double>(result.frames) / seconds : 0.0);
+    if (!result.found) {
+        spdlog::error("No path to the goal found within {} steps and {} states", options->config.max_steps,
+                      options->config.max_states);
+        return 2;
+    }
+
+    fmt::print("shortest path: {} steps of {} frames\n", result.path.size(), options->config.frames_per_step);
+    for (std::size_t idx = 0; idx < result.path.size(); idx++) {
+        fmt::print("frame {}: keys {}\n", options->start_frames + idx * options->config.frames_per_step,
+                   keys_to_string(result.path[idx]));
+    }
+
+    if (!options->script.empty()) {
+        std::ofstream script(options->script);
+        for (const auto &event: chip8::search::to_input(result.path, options->start_frames, options->config.frames_per_step)) {
+            script << fmt::format("{} {:X} {}\n", event.frame, event.key, event.pressed ? "down" : "up");
+        }
+        if (!script) {
+            spdlog::error("Could not write file: {}", options->script);
+            return 1;
+        }
+    }
+    return 0;
+}
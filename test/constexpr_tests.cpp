@@ -1,5 +1,7 @@
 #include <catch2/catch.hpp>
 #include "utilities/Map.h"
+#include "utilities/Random.h"
+#include "chip8/OpcodeDecoding.h"
 #include "chip8/OpcodeToString.h"
 
 TEST_CASE("constexpr opcodeAssemblyMap - simple", "[constexpr opcodeAssemblyMap]")
@@ -40,4 +42,19 @@ TEST_CASE("opcode to assembly instruction") {
         static constexpr uint16_t opcode = 0xE000;
         STATIC_REQUIRE(chip8::opcode_to_assembler(opcode) == "Invalid opcode");
     }
-}
\ No newline at end of file
+}
+TEST_CASE("opcode validity") {
+    STATIC_REQUIRE(chip8::is_valid_opcode(0x8ab7));
+    STATIC_REQUIRE(chip8::is_valid_opcode(0xF165));
+    STATIC_REQUIRE_FALSE(chip8::is_valid_opcode(0x8ab8));
+    STATIC_REQUIRE_FALSE(chip8::is_valid_opcode(0xE000));
+    STATIC_REQUIRE_FALSE(chip8::is_valid_opcode(0x00E1));
+}
+TEST_CASE("pcg32 reference sequence") {
+    // first numbers of the pcg32 demo program for seed 42 and stream 54
+    static constexpr auto numbers = [] {
+        Pcg32 generator(42, 54);
+        return std::array{generator.next(), generator.next(), generator.next()};
+    }();
+    STATIC_REQUIRE(numbers == std::array{0xa15c02b7U, 0x7b47f409U, 0xba1d3330U});
+}
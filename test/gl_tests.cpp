@@ -0,0 +1,226 @@
+#include <catch2/catch.hpp>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/glew.h>
+
+#include "chip8/Chip8.h"
+#include "chip8/EmulationThread.h"
+#include "chip8/MazeDemo.h"
+#include "utilities/Canvas.h"
+#include "utilities/PackedDisplayTexture.h"
+
+// Smoke tests of the display upload on a real OpenGL 3.3 core context without window, e.g. Mesa's
+// llvmpipe through the surfaceless EGL platform (LIBGL_ALWAYS_SOFTWARE=1).
+namespace chip8_gl_tests {
+    using Rows = chip8::Chip8::DisplayRows;
+    constexpr auto width = chip8::Chip8::screen_width;
+    constexpr auto height = chip8::Chip8::screen_height;
+
+    class Context {
+      public:
+        Context() {
+            const auto get_platform_display =
+                    reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT")); // NOLINT EGL entry point
+            display = get_platform_display != nullptr
+                              ? get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr)
+                              : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+            if (display == EGL_NO_DISPLAY || eglInitialize(display, nullptr, nullptr) == EGL_FALSE) { return; }
+            eglBindAPI(EGL_OPENGL_API);
+            // the tests render into frame buffer objects, neither a surface nor a config is needed
+            static constexpr std::array<EGLint, 7> context_attributes{
+                    EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+                    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+            context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, context_attributes.data());
+            if (context == EGL_NO_CONTEXT || eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context) == EGL_FALSE) {
+                return;
+            }
+            glewExperimental = GL_TRUE;
+            // GLEW built for GLX finds no GLX display, the GL entry points are loaded nonetheless
+            const auto glew = glewInit();
+            valid = glew == GLEW_OK || glew == GLEW_ERROR_NO_GLX_DISPLAY;
+        }
+        ~Context() {
+            if (context != EGL_NO_CONTEXT) {
+                eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+                eglDestroyContext(display, context);
+            }
+            if (display != EGL_NO_DISPLAY) { eglTerminate(display); }
+        }
+        Context(Context &) = delete;
+        Context(Context &&) = delete;
+        Context operator=(Context &) = delete;
+        Context operator=(Context &&) = delete;
+
+        [[nodiscard]] bool is_valid() const { return valid; }
+
+      private:
+        EGLDisplay display = EGL_NO_DISPLAY;
+        EGLContext context = EGL_NO_CONTEXT;
+        bool valid = false;
+    };
+
+    // every row differs and has set and cleared pixels in every byte
+    Rows test_pattern(uint64_t seed) {
+        Rows rows{};
+        auto value = seed;
+        for (auto &row: rows) {
+            value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+            row = value ^ (value >> 29U);
+        }
+        return rows;
+    }
+
+    bool pixel(const Rows &rows, std::size_t x, std::size_t y) { return ((rows[y] >> (63 - x)) & 1U) != 0; }
+
+    Rows read_texture(const PackedDisplayTexture &texture) {
+        std::array<uint8_t, sizeof(Rows)> bytes{};
+        glBindTexture(GL_TEXTURE_2D, texture.get_texture());
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, bytes.data());
+        Rows rows{};
+        for (std::size_t idx = 0; idx < bytes.size(); idx++) {
+            rows[idx / 8] |= static_cast<uint64_t>(bytes[idx]) << (8 * (idx % 8));
+        }
+        return rows;
+    }
+
+    std::string read_file(const std::string &filename) {
+        std::ifstream file(filename);
+        std::stringstream source;
+        source << file.rdbuf();
+        return source.str();
+    }
+
+    GLuint compile_shader(GLenum type, const std::string &filename) {
+        const auto source = read_file(filename);
+        const auto *text = source.c_str();
+        const auto shader = glCreateShader(type);
+        glShaderSource(shader, 1, &text, nullptr);
+        glCompileShader(shader);
+        GLint success = 0;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        REQUIRE(success == GL_TRUE);
+        return shader;
+    }
+
+    // render the texture with the shaders of the GUI into a display sized frame buffer, the pixel
+    // colors are read back bottom row first
+    std::array<uint8_t, 4 * width * height> render(const PackedDisplayTexture &texture) {
+        const auto vertex = compile_shader(GL_VERTEX_SHADER, CHIP8_SHADER_DIR "/vertexShader.glsl");
+        const auto fragment = compile_shader(GL_FRAGMENT_SHADER, CHIP8_SHADER_DIR "/fragmentShader.glsl");
+        const auto program = glCreateProgram();
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+        glLinkProgram(program);
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        REQUIRE(linked == GL_TRUE);
+
+        GLuint target = 0;
+        glGenTextures(1, &target);
+        glBindTexture(GL_TEXTURE_2D, target);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        GLuint frame_buffer = 0;
+        glGenFramebuffers(1, &frame_buffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+        REQUIRE(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+        const Canvas canvas;
+        glViewport(0, 0, width, height);
+        glUseProgram(program);
+        glBindTexture(GL_TEXTURE_2D, texture.get_texture());
+        canvas.draw();
+        std::array<uint8_t, 4 * width * height> pixels{};
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &frame_buffer);
+        glDeleteTextures(1, &target);
+        glDeleteProgram(program);
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        return pixels;
+    }
+
+
+    TEST_CASE("the packed display texture holds the uploaded rows")
+    {
+        const Context context;
+        REQUIRE(context.is_valid());
+        const auto use_pixel_buffers = GENERATE(false, true);
+        PackedDisplayTexture texture(use_pixel_buffers);
+
+        SECTION("snapshots, skipped frames and dirty rows")
+        {
+            auto snapshot = std::make_unique<chip8::Snapshot>();
+            snapshot->display_rows = test_pattern(1);
+            texture.load_texture(*snapshot);
+            REQUIRE(read_texture(texture) == snapshot->display_rows);
+
+            // the next frames upload the range of the dirty rows, the pixel buffer ring moves on every
+            // frame. Rows between dirty ones did not change, rows outside the range are not uploaded.
+            auto expected = snapshot->display_rows;
+            for (std::size_t frame = 1; frame < 8; frame++) {
+                auto rows = test_pattern(frame + 1);
+                const auto first = 3 * frame;
+                const auto dirty = chip8::Chip8::DirtyRows{0b1011} << first;
+                rows[first + 2] = expected[first + 2];
+                snapshot->frame = frame;
+                snapshot->display_rows = rows;
+                snapshot->dirty_rows = dirty;
+                texture.load_texture(*snapshot);
+                for (const auto row: {first, first + 1, first + 3}) { expected[row] = rows[row]; }
+                REQUIRE(read_texture(texture) == expected);
+            }
+
+            // after a dropped frame everything is uploaded
+            snapshot->frame = 10;
+            snapshot->display_rows = test_pattern(99);
+            snapshot->dirty_rows = 0;
+            texture.load_texture(*snapshot);
+            REQUIRE(read_texture(texture) == snapshot->display_rows);
+        }
+
+        SECTION("a running program")
+        {
+            auto chip8 = std::make_unique<chip8::Chip8>();
+            chip8->set_seed(0xC8);
+            chip8->load_rom(maze_data);
+            chip8->toggle_pause();
+            for (int frame = 0; frame < 40; frame++) {
+                chip8->tick();
+                texture.load_texture(*chip8);
+                REQUIRE(read_texture(texture) == chip8->get_display_rows());
+            }
+        }
+    }
+
+    TEST_CASE("the fragment shader unpacks the display texture")
+    {
+        const Context context;
+        REQUIRE(context.is_valid());
+        PackedDisplayTexture texture;
+        auto snapshot = std::make_unique<chip8::Snapshot>();
+        snapshot->display_rows = test_pattern(7);
+        texture.load_texture(*snapshot);
+
+        const auto pixels = render(texture);
+        for (std::size_t y = 0; y < height; y++) {
+            for (std::size_t x = 0; x < width; x++) {
+                // blue is 1.0 for set pixels and 0.1 for cleared ones
+                const auto blue = pixels[4 * ((height - 1 - y) * width + x) + 2];
+                INFO("pixel " << x << "," << y);
+                REQUIRE((blue > 128) == pixel(snapshot->display_rows, x, y));
+            }
+        }
+    }
+
+} // namespace chip8_gl_tests
@@ -1,7 +1,11 @@
 #include <catch2/catch.hpp>
+#include <cstring>
 #include <filesystem>
+#include <sstream>
 
+#include "chip8/Batch.h"
 #include "chip8/Chip8.h"
+#include "chip8/Search.h"
 
 namespace chip8_tests {
     namespace fs = std::filesystem;
@@ -67,4 +71,192 @@ namespace chip8_tests {
         }
     }
 
+
+    TEST_CASE("statically recompiled ROM matches the interpreter")
+    {
+        const auto rom = fs::path(roms_path).append("test_program.ch8");
+        chip8::Chip8 interpreter;
+        chip8::Chip8 recompiled;
+        recompiled.set_backend(chip8::Backend::Aot);
+        for (auto *chip8: {&interpreter, &recompiled}) {
+            chip8->load_rom_from_file(rom.string());
+            chip8->toggle_pause();
+        }
+        REQUIRE(recompiled.has_recompiled_rom());
+
+        // move the eagle around with the keys W, S, A, D (5, 8, 7, 9)
+        static constexpr std::array<std::size_t, 4> moves{5, 8, 7, 9};
+        for (int frame = 0; frame < 200; frame++) {
+            for (auto *chip8: {&interpreter, &recompiled}) {
+                chip8->keys = {};
+                chip8->keys[moves[static_cast<std::size_t>(frame / 20) % moves.size()]] = true;
+                chip8->tick();
+            }
+            REQUIRE(recompiled.get_registers() == interpreter.get_registers());
+            REQUIRE(recompiled.get_pc() == interpreter.get_pc());
+            REQUIRE(recompiled.get_i() == interpreter.get_i());
+            REQUIRE(recompiled.get_tick_count() == interpreter.get_tick_count());
+            REQUIRE(recompiled.get_display_buffer() == interpreter.get_display_buffer());
+        }
+    }
+
+    TEST_CASE("save states restore the machine")
+    {
+        const auto rom = fs::path(roms_path).append(GENERATE("test_program.ch8", "simple.ch8", "test.ch8"));
+        const auto backend = GENERATE(chip8::Backend::Interpreter, chip8::Backend::Jit);
+        static constexpr std::array<std::size_t, 4> moves{5, 8, 7, 9};
+        // the hashes of the frames following frame
+        const auto run = [](chip8::Chip8 &chip8, int frame, int frames) {
+            std::vector<uint64_t> hashes;
+            for (; frames > 0; frame++, frames--) {
+                chip8.keys = {};
+                chip8.keys[moves[static_cast<std::size_t>(frame / 20) % moves.size()]] = true;
+                chip8.tick();
+                hashes.push_back(chip8.state_hash());
+            }
+            return hashes;
+        };
+
+        chip8::Chip8 chip8;
+        chip8.set_seed(3);
+        chip8.set_backend(backend);
+        chip8.load_rom_from_file(rom.string());
+        REQUIRE(chip8.get_rom_size() > 0);
+        chip8.toggle_pause();
+        REQUIRE(chip8.get_state() == chip8::State::Running);
+        run(chip8, 0, 50);
+        const auto saved = chip8.save_state();
+        const auto expected = run(chip8, 50, 100);
+
+        REQUIRE(chip8.load_state(saved));
+        const auto again = chip8.save_state();
+        REQUIRE(std::memcmp(&again, &saved, sizeof(saved)) == 0);
+        REQUIRE(run(chip8, 50, 100) == expected);
+
+        // another instance with the ROM loaded continues the same way
+        chip8::Chip8 restored;
+        restored.set_backend(backend);
+        restored.load_rom_from_file(rom.string());
+        REQUIRE(restored.load_state(saved));
+        REQUIRE(run(restored, 50, 100) == expected);
+
+        auto incompatible = saved;
+        incompatible.version++;
+        REQUIRE_FALSE(restored.load_state(incompatible));
+        REQUIRE(restored.state_hash() == chip8.state_hash());
+
+        // the state belongs to the ROM it was saved with
+        REQUIRE(saved.rom_hash == chip8.get_rom_hash());
+        REQUIRE(saved.rom_size == chip8.get_rom_size());
+        chip8::Chip8 other;
+        other.load_rom(std::array<uint8_t, 2>{0x12, 0x00});
+        const auto other_hash = other.state_hash();
+        REQUIRE_FALSE(other.load_state(saved));
+        REQUIRE(other.state_hash() == other_hash);
+
+        // a damaged block cannot point the backends outside of memory
+        auto damaged = saved;
+        damaged.state = static_cast<chip8::State>(7);
+        REQUIRE_FALSE(restored.load_state(damaged));
+        damaged = saved;
+        damaged.pc = 0xFFFF;
+        damaged.stack.fill(0x1FFF);
+        REQUIRE(restored.load_state(damaged));
+        REQUIRE(restored.get_pc() == chip8::Chip8::address_mask);
+        restored.tick();
+    }
+
+    TEST_CASE("batch jobs give the same results on any number of threads")
+    {
+        std::istringstream manifest(
+                "# the same run on every backend\n"
+                "rom=test_program.ch8 frames=120 seed=7 hashes=1 name=interpreter\n"
+                "rom=test_program.ch8 frames=120 seed=7 hashes=1 backend=threaded\n"
+                "\n"
+                "rom=test_program.ch8 frames=120 seed=7 hashes=1 backend=jit idle=0\n"
+                "rom=test_program.ch8 frames=120 seed=7 hashes=1 backend=aot cycles=8\n"
+                "rom=test_program.ch8 frames=50 seed=8 cycles=100 shift=vx stack=4\n");
+        auto jobs = chip8::batch::parse_manifest(manifest, roms_path);
+        REQUIRE(jobs.has_value());
+        REQUIRE(jobs->size() == 5);
+        REQUIRE((*jobs)[0].name == "interpreter");
+        REQUIRE((*jobs)[1].name == "3");
+        REQUIRE((*jobs)[0].rom == (*jobs)[4].rom);
+
+        std::istringstream script("10 5 down\n30 5 up\n40 9 down\n");
+        const auto input = chip8::batch::parse_input(script);
+        REQUIRE(input.has_value());
+        for (int copy = 0; copy < 20; copy++) {
+            for (std::size_t job = 0; job < 5; job++) { jobs->push_back((*jobs)[job]); }
+        }
+        for (auto &job: *jobs) { job.input = *input; }
+
+        std::vector<chip8::batch::Result> expected;
+        for (std::size_t job = 0; job < jobs->size(); job++) { expected.push_back(chip8::batch::run_job((*jobs)[job], job)); }
+        REQUIRE(expected[0].frames == 120);
+        REQUIRE(expected[0].frame_hashes.size() == 120);
+        for (std::size_t job = 1; job < 4; job++) {
+            REQUIRE(expected[job].state_hash == expected[0].state_hash);
+            REQUIRE(expected[job].frame_hashes == expected[0].frame_hashes);
+        }
+
+        const auto threads = GENERATE(1U, 3U, 8U);
+        std::vector<int> seen(jobs->size());
+        chip8::batch::run(*jobs, threads, [&](const chip8::batch::Result &result) {
+            seen[result.job]++;
+            REQUIRE(result.state_hash == expected[result.job].state_hash);
+            REQUIRE(result.frame_hashes == expected[result.job].frame_hashes);
+            REQUIRE(result.instructions == expected[result.job].instructions);
+        });
+        REQUIRE(std::ranges::all_of(seen, [](int count) { return count == 1; }));
+    }
+
+    TEST_CASE("input search finds the shortest key sequence to a goal")
+    {
+        // a lock that opens with key 3 and then key 7, storing 7 at 0x300
+        const std::vector<uint8_t> rom{
+            0x60, 0x03, // ld v0, 3
+            0xE0, 0xA1, // skip if key v0 not pressed
+            0x12, 0x08, // goto 0x208
+            0x12, 0x00, // goto 0x200
+            0x60, 0x07, // ld v0, 7
+            0xE0, 0xA1, // skip if key v0 not pressed
+            0x12, 0x10, // goto 0x210
+            0x12, 0x08, // goto 0x208
+            0xA3, 0x00, // ld I, 0x300
+            0xF0, 0x55, // ld [I], v0
+            0x12, 0x14  // goto 0x214
+        };
+        chip8::Chip8 chip8;
+        chip8.set_seed(0);    // the seed of a batch job
+        chip8.load_rom(rom);
+        chip8.toggle_pause();
+        const auto start = chip8.save_state();
+        const auto opened = [](const chip8::Chip8 &state) { return state.get_memory()[0x300] == 7; };
+
+        chip8::search::Config config;
+        config.threads = GENERATE(1U, 4U);
+        const auto result = chip8::search::find_shortest_path(rom, start, opened, config);
+        REQUIRE(result.found);
+        REQUIRE(result.path == std::vector<uint16_t>{1U << 3U, 1U << 7U});
+        // waiting with no key or a wrong one leads to states seen before
+        REQUIRE(result.states < 3 * chip8::search::branches);
+
+        // the path as input script of a batch job
+        chip8::batch::Job job;
+        job.rom = std::make_shared<const std::vector<uint8_t>>(rom);
+        job.frames = result.path.size();
+        job.input = chip8::search::to_input(result.path, 0, 1);
+        REQUIRE(job.input.size() == 4);
+        for (const auto keys: result.path) {
+            chip8.set_key_mask(keys);
+            chip8.tick();
+        }
+        REQUIRE(opened(chip8));
+        REQUIRE(chip8::batch::run_job(job, 0).state_hash == chip8.state_hash());
+
+        config.max_steps = 1;
+        REQUIRE_FALSE(chip8::search::find_shortest_path(rom, start, opened, config).found);
+    }
+
 }
@@ -0,0 +1,73 @@
+// Compares the display expansion kernels with the previous get_screen implementation, which
+// expanded the byte-wise display buffer with std::bitset.
+//
+// usage: screen_benchmark [iterations]
+
+#include <bitset>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "chip8/Chip8.h"
+#include "chip8/PixelExpansion.h"
+
+namespace {
+    using Screen = std::array<uint8_t, chip8::Chip8::screen_size>;
+
+    Screen bitset_screen(const std::array<uint8_t, 8 * chip8::Chip8::screen_height> &display_buffer) {
+        Screen screen{0};
+        std::for_each(display_buffer.rbegin(), display_buffer.rend(), [&screen, idx = std::size_t{0}](uint8_t byte) mutable {
+            std::bitset<8> bitIsSet{byte};
+            for (std::size_t i = 0; i < 8; i++) {
+                screen[idx] = bitIsSet[i] ? 0xFF : 0x0;
+                idx++;
+            }
+        });
+        return screen;
+    }
+
+    template<typename Fn>
+    double nanoseconds_per_call(long iterations, Fn &&fn) {
+        const auto start = std::chrono::steady_clock::now();
+        for (long i = 0; i < iterations; i++) { fn(); }
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / static_cast<double>(iterations);
+    }
+}
+
+int main(int argc, char **argv) {
+    const long iterations = argc > 1 ? std::stol(argv[1]) : 200000;
+
+    chip8::Chip8 chip8; // shows the start screen
+    const auto display_buffer = chip8.get_display_buffer();
+    const auto &rows = chip8.get_display_rows();
+    Screen screen{};
+    std::array<uint8_t, 4 * chip8::Chip8::screen_size> image{};
+    volatile uint8_t sink = 0;
+
+    const auto reference = nanoseconds_per_call(iterations, [&] { sink = sink + bitset_screen(display_buffer)[1000]; });
+    spdlog::info("{:<24} {:8.1f} ns", "bitset (previous)", reference);
+
+    const std::vector<std::pair<const char *, chip8::pixels::Kernel>> kernels{
+            {"scalar", chip8::pixels::Kernel::Scalar},
+            {"sse2", chip8::pixels::Kernel::Sse2},
+            {"avx2", chip8::pixels::Kernel::Avx2},
+    };
+    for (const auto &[name, kernel]: kernels) {
+        if (kernel > chip8::pixels::best_kernel()) { continue; }
+        const auto time = nanoseconds_per_call(iterations, [&] {
+            chip8::pixels::expand_rows(rows, screen, kernel);
+            sink = sink + screen[1000];
+        });
+        spdlog::info("{:<24} {:8.1f} ns  {:5.1f}x", name, time, reference / time);
+    }
+
+    const auto rgba = nanoseconds_per_call(iterations, [&] {
+        chip8.get_screen_rgba(image);
+        sink = sink + image[1000];
+    });
+    spdlog::info("{:<24} {:8.1f} ns", "rgba (best kernel)", rgba);
+    return 0;
+}
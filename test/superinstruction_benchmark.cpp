@@ -0,0 +1,103 @@
+// Instructions per second of the interpreter backend with and without superinstructions, for the
+// maze demo and the test ROMs.
+//
+// usage: superinstruction_benchmark [instructions] [rom.ch8]...
+//
+// Without ROM arguments the ROMs in test_roms/ are run, as from the test directory of the build.
+// Idle loops are executed instead of skipped, the skipped instructions would count as run. A
+// program reaching an idle loop, like the maze demo once the maze is drawn, is loaded again; only
+// the time spent running instructions is measured. A program that stops ends its measurement.
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "chip8/Chip8.h"
+#include "chip8/MazeDemo.h"
+
+namespace {
+    // instructions run between the checks for a reload
+    constexpr int instructions_per_run = 1000;
+
+    struct Result {
+        double instructions_per_second = 0;
+        std::size_t instructions = 0;
+        std::size_t reloads = 0;
+        bool stopped = false;
+    };
+
+    Result measure(const std::vector<uint8_t> &rom, bool superinstructions, std::size_t instructions) {
+        chip8::Chip8 chip8;
+        chip8.set_idle_skipping(false);
+        chip8.set_superinstructions(superinstructions);
+        const auto restart = [&chip8, &rom] {
+            chip8.set_seed(0xC8);
+            chip8.load_rom(rom);
+            chip8.toggle_pause();
+        };
+
+        Result result;
+        std::chrono::duration<double> elapsed{0};
+        restart();
+        while (result.instructions < instructions) {
+            const auto before = chip8.get_tick_count();
+            const auto start = std::chrono::steady_clock::now();
+            chip8.run_instructions(instructions_per_run);
+            elapsed += std::chrono::steady_clock::now() - start;
+            result.instructions += chip8.get_tick_count() - before;
+            if (chip8.get_state() != chip8::State::Running) {
+                result.stopped = true;
+                break;
+            }
+            if (chip8.is_idle()) {
+                restart();
+                result.reloads++;
+            }
+        }
+        if (elapsed.count() > 0) { result.instructions_per_second = static_cast<double>(result.instructions) / elapsed.count(); }
+        return result;
+    }
+
+    std::vector<uint8_t> read_rom(const std::string &filename) {
+        std::ifstream file(filename, std::ios::binary);
+        file >> std::noskipws;
+        return {std::istream_iterator<uint8_t>(file), std::istream_iterator<uint8_t>()};
+    }
+}
+
+int main(int argc, char **argv) {
+    const std::vector<std::string> args(argv, argv + argc);
+    const std::size_t instructions = args.size() > 1 ? std::stoull(args[1]) : 50'000'000;
+    std::vector<std::string> files(args.begin() + std::min<std::ptrdiff_t>(2, argc), args.end());
+    if (files.empty()) { files = {"test_roms/test_program.ch8", "test_roms/test.ch8", "test_roms/simple.ch8"}; }
+
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> roms{
+            {"MazeDemo.h", {maze_data.begin(), maze_data.end()}}};
+    for (const auto &file: files) {
+        auto rom = read_rom(file);
+        if (rom.empty() || rom.size() > chip8::Chip8::mem_size - chip8::Chip8::pc_start_address) {
+            spdlog::warn("Skipping {}, could not read a ROM from it", file);
+            continue;
+        }
+        roms.emplace_back(file, std::move(rom));
+    }
+
+    spdlog::info("{:<28} {:>14} {:>14} {:>8}", "ROM", "plain IPS", "fused IPS", "speedup");
+    for (const auto &[name, rom]: roms) {
+        const auto plain = measure(rom, false, instructions);
+        const auto fused = measure(rom, true, instructions);
+        if (plain.stopped || fused.stopped) {
+            spdlog::warn("{} stopped after {} instructions, not measured", name, fused.instructions);
+            continue;
+        }
+        spdlog::info("{:<28} {:>14.0f} {:>14.0f} {:>7.2f}x  ({} reloads)", name, plain.instructions_per_second,
+                     fused.instructions_per_second, fused.instructions_per_second / plain.instructions_per_second,
+                     fused.reloads);
+    }
+    return 0;
+}
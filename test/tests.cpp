@@ -1,7 +1,19 @@
 #include <catch2/catch.hpp>
+#include <cstring>
+#include <limits>
+#include <sstream>
 
 #include "chip8/OpcodeToString.h"
 #include "chip8/Chip8.h"
+#include "chip8/EmulationClock.h"
+#include "chip8/EmulationThread.h"
+#include "chip8/Lockstep.h"
+#include "chip8/Movie.h"
+#include "chip8/Rewind.h"
+#include "chip8/RunAhead.h"
+#include "utilities/SpscQueue.h"
+#include "utilities/TripleBuffer.h"
+#include "utilities/WorkStealingPool.h"
 
 namespace chip8_tests {
     using namespace std::literals::string_view_literals;
@@ -800,6 +812,945 @@ namespace chip8_tests {
     }
 
 
+    TEST_CASE("op_draw - 0xDxyn wraps around the screen edges")
+    {
+        chip8::Chip8 chip8;
+        chip8.load_rom(to_bit8_program<6>({
+            0x00E0, // clear screen
+            0x603E, // ld vx nn - x = 62
+            0x611E, // ld vx nn - y = 30
+            0xA000, // ld I nnn - sprite of digit 0
+            0xD015, // draw
+            0xD015  // draw again
+        }));
+        for (auto i = 0; i < 5; i++) { chip8.exec_op_cycle(); }
+        const auto &rows = chip8.get_display_rows();
+        REQUIRE(rows[30] == 0xC000000000000003);
+        REQUIRE(rows[31] == 0x4000000000000002);
+        REQUIRE(rows[2] == 0xC000000000000003);
+        REQUIRE(rows[3] == 0);
+        REQUIRE(chip8.get_registers()[0xF] == 0);
+
+        const auto bytes = chip8.get_display_buffer();
+        REQUIRE(bytes[30 * 8] == 0xC0);
+        REQUIRE(bytes[30 * 8 + 7] == 0x03);
+        const auto screen = chip8.get_screen();
+        REQUIRE(screen[1 * 64] == 0xFF);
+        REQUIRE(screen[1 * 64 + 1] == 0xFF);
+        REQUIRE(screen[1 * 64 + 2] == 0x00);
+        REQUIRE(screen[1 * 64 + 63] == 0xFF);
+
+        chip8.exec_op_cycle();
+        REQUIRE(chip8.get_registers()[0xF] == 1);
+        REQUIRE(chip8.get_display_rows()[30] == 0);
+    }
+
+    TEST_CASE("dirty rows are tracked per display consumer")
+    {
+        chip8::Chip8 chip8;
+        chip8.load_rom(to_bit8_program<5>({
+            0x6000, // ld vx nn - x = 0
+            0x611E, // ld vx nn - y = 30
+            0xA000, // ld I nnn
+            0xD014, // draw 4 lines: rows 30, 31, 0, 1
+            0x00E0  // clear screen
+        }));
+        const auto texture = chip8.add_display_consumer();
+        const auto recorder = chip8.add_display_consumer();
+        REQUIRE(chip8.take_dirty_rows(texture) == chip8::Chip8::all_rows_dirty);
+        REQUIRE(chip8.take_dirty_rows(texture) == 0);
+
+        for (auto i = 0; i < 4; i++) { chip8.exec_op_cycle(); }
+        REQUIRE(chip8.take_dirty_rows(texture) == 0xC0000003);
+        REQUIRE(chip8.take_dirty_rows(recorder) == chip8::Chip8::all_rows_dirty);
+
+        chip8.exec_op_cycle();
+        REQUIRE(chip8.take_dirty_rows(recorder) == chip8::Chip8::all_rows_dirty);
+        REQUIRE(chip8.take_dirty_rows(texture) == chip8::Chip8::all_rows_dirty);
+        REQUIRE(chip8.take_dirty_rows(recorder) == 0);
+
+        // consumers beyond the limit are not tracked and redraw everything
+        for (std::size_t consumer = 2; consumer < chip8::Chip8::max_display_consumers; consumer++) {
+            REQUIRE(chip8.add_display_consumer() == consumer);
+        }
+        const auto untracked = chip8.add_display_consumer();
+        REQUIRE(untracked == chip8::Chip8::untracked_consumer);
+        REQUIRE(chip8.take_dirty_rows(untracked) == chip8::Chip8::all_rows_dirty);
+        REQUIRE(chip8.take_dirty_rows(untracked) == chip8::Chip8::all_rows_dirty);
+        REQUIRE(chip8.take_dirty_rows(texture) == 0);
+    }
+
+    TEST_CASE("pixel expansion kernels agree with a bit by bit expansion")
+    {
+        std::vector<chip8::pixels::Kernel> kernels{chip8::pixels::Kernel::Scalar};
+        if (chip8::pixels::best_kernel() != chip8::pixels::Kernel::Scalar) { kernels.push_back(chip8::pixels::Kernel::Sse2); }
+        if (chip8::pixels::best_kernel() == chip8::pixels::Kernel::Avx2) { kernels.push_back(chip8::pixels::Kernel::Avx2); }
+
+        chip8::Chip8::DisplayRows rows{};
+        Pcg32 generator(7);
+        for (auto &row: rows) { row = (uint64_t{generator.next()} << 32U) | generator.next(); }
+        rows[0] = 0;
+        rows[1] = ~uint64_t{0};
+
+        for (const auto kernel: kernels) {
+            std::array<uint8_t, chip8::Chip8::screen_size> bytes{};
+            chip8::pixels::expand_rows(rows, bytes, kernel);
+            for (std::size_t idx = 0; idx < bytes.size(); idx++) {
+                REQUIRE(bytes[idx] == (((rows[idx / 64] >> (idx % 64)) & 1U) != 0 ? 0xFF : 0x00));
+            }
+
+            const chip8::pixels::Palette palette{{1, 2, 3, 4}, {5, 6, 7, 8}};
+            std::array<uint8_t, 4 * chip8::Chip8::screen_size> image{};
+            chip8::pixels::expand_rows_rgba(rows, image, palette, kernel);
+            for (std::size_t idx = 0; idx < chip8::Chip8::screen_size; idx++) {
+                const auto set = ((rows[idx / 64] >> (63 - idx % 64)) & 1U) != 0;
+                for (std::size_t channel = 0; channel < 4; channel++) {
+                    REQUIRE(image[4 * idx + channel] == (set ? 5 : 1) + channel);
+                }
+            }
+        }
+    }
+
+    TEST_CASE("invalid opcode stops the emulator")
+    {
+        chip8::Chip8 chip8;
+        chip8.load_rom(to_bit8_program<2>({
+            0x6301, // ld vx nn
+            0xE000  // invalid
+        }));
+        chip8.toggle_pause();
+        chip8.tick();
+        REQUIRE(chip8.get_state() == chip8::State::Empty);
+        REQUIRE(chip8.get_registers()[3] == 1);
+        REQUIRE(chip8.get_fault().fault == chip8::Fault::InvalidOpcode);
+        REQUIRE(chip8.get_fault().pc == 0x202);
+        REQUIRE(chip8.get_fault().opcode == 0xE000);
+    }
+
+    TEST_CASE("memory accesses wrap around at the end of memory")
+    {
+        chip8::Chip8 chip8;
+        chip8.load_rom(to_bit8_program<8>({
+            0x6011, // ld vx nn
+            0x6122, // ld vx nn
+            0x6233, // ld vx nn
+            0xAFFE, // ld I nnn
+            0xF255, // regdump: 0xFFE, 0xFFF, 0x000
+            0xAFFF, // ld I nnn
+            0xF165, // regload: 0xFFF, 0x000
+            0xBFFF  // goto nnn + v0: wraps to 0x021
+        }));
+        for (auto i = 0; i < 8; i++) { chip8.exec_op_cycle(); }
+        REQUIRE(chip8.get_memory()[0xFFE] == 0x11);
+        REQUIRE(chip8.get_memory()[0xFFF] == 0x22);
+        REQUIRE(chip8.get_memory()[0x000] == 0x33);
+        REQUIRE(chip8.get_registers()[0] == 0x22);
+        REQUIRE(chip8.get_registers()[1] == 0x33);
+        REQUIRE(chip8.get_pc() == 0x021);
+        REQUIRE(chip8.get_fault().fault == chip8::Fault::None);
+    }
+
+    TEST_CASE("save states keep a PC at the last byte of memory")
+    {
+        chip8::Chip8 chip8;
+        chip8.load_rom(to_bit8_program<1>({
+            0x1FFF  // goto 0xFFF
+        }));
+        chip8.toggle_pause();
+        chip8.exec_op_cycle();
+        REQUIRE(chip8.get_pc() == 0xFFF);
+
+        const auto saved = chip8.save_state();
+        const auto hash = chip8.state_hash();
+        REQUIRE(chip8.load_state(saved));
+        REQUIRE(chip8.get_pc() == 0xFFF);
+        REQUIRE(chip8.state_hash() == hash);
+        const auto again = chip8.save_state();
+        REQUIRE(std::memcmp(&again, &saved, sizeof(saved)) == 0);
+    }
+
+    TEST_CASE("stack overflow and underflow stop the emulator")
+    {
+        const auto backend = GENERATE(chip8::Backend::Interpreter, chip8::Backend::Threaded, chip8::Backend::Jit);
+        chip8::Chip8 chip8;
+        chip8.set_backend(backend);
+        chip8.cycles_per_frame = 100;
+
+        SECTION("runaway recursion") {
+            chip8.set_stack_depth(12);
+            chip8.load_rom(to_bit8_program<1>({
+                0x2200  // call 0x200
+            }));
+            chip8.toggle_pause();
+            chip8.tick();
+            REQUIRE(chip8.get_state() == chip8::State::Empty);
+            REQUIRE(chip8.get_stack_pointer() == 12);
+            REQUIRE(chip8.get_tick_count() == 12);
+            REQUIRE(chip8.get_fault().fault == chip8::Fault::StackOverflow);
+            REQUIRE(chip8.get_fault().pc == 0x200);
+        }
+        SECTION("return without call") {
+            chip8.load_rom(to_bit8_program<2>({
+                0x6301, // ld vx nn
+                0x00EE  // return
+            }));
+            chip8.toggle_pause();
+            chip8.tick();
+            REQUIRE(chip8.get_state() == chip8::State::Empty);
+            REQUIRE(chip8.get_tick_count() == 1);
+            REQUIRE(chip8.get_fault().fault == chip8::Fault::StackUnderflow);
+            REQUIRE(chip8.get_fault().pc == 0x202);
+        }
+    }
+
+    TEST_CASE("instruction history keeps the newest instructions")
+    {
+        chip8::Chip8 chip8;
+        chip8.load_rom(to_bit8_program<3>({
+            0x7001, // add vx nn
+            0x7101, // add vx nn
+            0x1200  // goto 0x200
+        }));
+        for (auto i = 0; i < 100; i++) { chip8.exec_op_cycle(); }
+
+        const auto &history = chip8.get_call_stack();
+        REQUIRE(history.size() == chip8::Chip8::history_size);
+        REQUIRE(history[0] == chip8::HistoryEntry{0x200, 0x7001});
+        REQUIRE(history[1] == chip8::HistoryEntry{0x204, 0x1200});
+        REQUIRE(history[2] == chip8::HistoryEntry{0x202, 0x7101});
+        REQUIRE(std::ranges::distance(history) == chip8::Chip8::history_size);
+    }
+
+    TEST_CASE("self modifying code - 0xFx55 overwrites an already executed instruction")
+    {
+        chip8::Chip8 chip8;
+        load_and_run(chip8, to_bit8_program<6>({
+            0x6B01, // ld vx nn - overwritten below
+            0x606B, // ld vx nn
+            0x6107, // ld vx nn
+            0xA200, // ld I nnn
+            0xF155, // regdump: 0x200 = 0x6B07
+            0x1200  // goto 0x200
+        }));
+        REQUIRE(chip8.get_registers()[0xB] == 0x01);
+        chip8.exec_op_cycle();
+        REQUIRE(chip8.get_registers()[0xB] == 0x07);
+    }
+    void require_same_state(const chip8::Chip8 &actual, const chip8::Chip8 &expected) {
+        REQUIRE(actual.get_registers() == expected.get_registers());
+        REQUIRE(actual.get_pc() == expected.get_pc());
+        REQUIRE(actual.get_i() == expected.get_i());
+        REQUIRE(actual.get_delay_timer() == expected.get_delay_timer());
+        REQUIRE(actual.get_sound_timer() == expected.get_sound_timer());
+        REQUIRE(actual.get_tick_count() == expected.get_tick_count());
+        REQUIRE(actual.get_memory() == expected.get_memory());
+        REQUIRE(actual.get_display_buffer() == expected.get_display_buffer());
+        REQUIRE(actual.state_hash() == expected.state_hash());
+    }
+
+    void compare_backends(chip8::Backend backend, const auto &program, int frames) {
+        chip8::Chip8 interpreter;
+        chip8::Chip8 other;
+        other.set_backend(backend);
+        for (auto *chip8: {&interpreter, &other}) {
+            chip8->set_seed(0xC8);
+            chip8->load_rom(program);
+            chip8->toggle_pause();
+        }
+        for (int frame = 0; frame < frames; frame++) {
+            interpreter.tick();
+            other.tick();
+            require_same_state(other, interpreter);
+        }
+    }
+
+    TEST_CASE("alternative backends match the interpreter")
+    {
+        const auto backend = GENERATE(chip8::Backend::Threaded, chip8::Backend::Jit);
+
+        SECTION("calls, draw, bcd and register dump")
+        {
+            compare_backends(backend, to_bit8_program<16>({
+                0x6005, // ld vx nn
+                0x6A00, // ld vx nn
+                0xF029, // ld F, vx
+                0xDAB5, // draw
+                0x7A09, // add vx nn
+                0x2212, // call 0x212
+                0x3A48, // skip if vx == nn
+                0x1204, // goto 0x204
+                0x1210, // goto 0x210 - halt
+                0x8104, // add vx vy
+                0x8216, // shift right
+                0xA300, // ld I nnn
+                0xF233, // bcd
+                0xF255, // regdump
+                0xF265, // regload
+                0x00EE  // return
+            }), 30);
+        }
+
+        SECTION("arithmetic, shifts and timers")
+        {
+            compare_backends(backend, to_bit8_program<18>({
+                0x61F0, // ld vx nn
+                0x6233, // ld vx nn
+                0x8125, // sub vx vy
+                0x8317, // subn vx vy
+                0x841E, // shift left
+                0x8F46, // shift right into VF
+                0x8F24, // add into VF
+                0x8312, // and vx vy
+                0x8431, // or vx vy
+                0x8543, // xor vx vy
+                0x8650, // ld vx vy
+                0xF61E, // add I vx
+                0xF315, // ld DT vx
+                0xF418, // ld ST vx
+                0xF707, // ld vx DT
+                0x71FF, // add vx nn
+                0x3100, // skip if vx == 0
+                0x1204  // goto 0x204
+            }), 60);
+        }
+
+        SECTION("self modifying code")
+        {
+            compare_backends(backend, to_bit8_program<7>({
+                0x6B01, // ld vx nn - overwritten below
+                0x7C01, // add vx nn
+                0x606B, // ld vx nn
+                0x610A, // ld vx nn
+                0xA200, // ld I nnn
+                0xF155, // regdump: 0x200 = 0x6B0A
+                0x1200  // goto 0x200
+            }), 10);
+        }
+
+        SECTION("random numbers")
+        {
+            compare_backends(backend, to_bit8_program<4>({
+                0xC0FF, // rand vx nn
+                0xC10F, // rand vx nn
+                0x8104, // add vx vy
+                0x1200  // goto 0x200
+            }), 10);
+        }
+    }
+
+    TEST_CASE("alternative backends match the interpreter after every instruction")
+    {
+        // regdump writes 0x2FC-0x305, across the 256 byte pages of the JIT: the running block at
+        // 0x200 and the subroutine at 0x300 compiled in the last round are both overwritten. The
+        // skip at 0x300 is a block of its own, it also runs compiled one instruction at a time.
+        static constexpr auto program = to_bit8_program<15>({
+            0x80B0, // ld vx vy - 0x2FC
+            0x6100, // ld vx nn
+            0x6200, // ld vx nn
+            0x6300, // ld vx nn
+            0x643D, // ld vx nn - 0x300 = 0x3DVB, skip if vx == nn
+            0x85B0, // ld vx vy
+            0x667D, // ld vx nn - 0x302 = 0x7D01, add vx nn
+            0x6701, // ld vx nn
+            0x6800, // ld vx nn - 0x304 = 0x00EE, return
+            0x69EE, // ld vx nn
+            0xA2FC, // ld I nnn
+            0xF955, // regdump
+            0x2300, // call 0x300
+            0x7B01, // add vx nn
+            0x1200  // goto 0x200
+        });
+        // the first round skips the add, the other 18 rounds run it
+        static constexpr int instructions = 17 + 18 * 18;
+        const auto backend = GENERATE(chip8::Backend::Threaded, chip8::Backend::Jit);
+        const auto step = GENERATE(1, 2, 3);
+
+        chip8::Chip8 interpreter;
+        chip8::Chip8 other;
+        other.set_backend(backend);
+        for (auto *chip8: {&interpreter, &other}) {
+            chip8->set_seed(0xC8);
+            chip8->load_rom(program);
+            chip8->toggle_pause();
+        }
+        for (int done = 0; done < instructions; done += step) {
+            interpreter.run_instructions(std::min(step, instructions - done));
+            other.run_instructions(std::min(step, instructions - done));
+            require_same_state(other, interpreter);
+        }
+        REQUIRE(other.get_pc() == 0x200);
+        REQUIRE(other.get_registers()[0xD] == 18);
+    }
 
+    TEST_CASE("jit blocks longer than a frame run natively")
+    {
+        // a block of 13 instructions, longer than the 8 instructions of a frame
+        static constexpr auto program = to_bit8_program<13>({
+            0x7001, 0x7001, 0x7001, 0x7001, 0x7001, 0x7001, // add vx nn
+            0x7001, 0x7001, 0x7001, 0x7001, 0x7001, 0x7001, // add vx nn
+            0x1200                                          // goto 0x200
+        });
+        chip8::Chip8 interpreter;
+        chip8::Chip8 jit;
+        jit.set_backend(chip8::Backend::Jit);
+        for (auto *chip8: {&interpreter, &jit}) {
+            chip8->set_seed(0xC8);
+            chip8->set_idle_skipping(false);
+            chip8->load_rom(program);
+            chip8->toggle_pause();
+        }
+        for (int frame = 0; frame < 600; frame++) {
+            interpreter.tick();
+            jit.tick();
+        }
+        require_same_state(jit, interpreter);
+        REQUIRE(jit.get_tick_count() == 600U * 8U);
+        // every instruction ran in a compiled block, also those of blocks left early at the end of a frame
+        REQUIRE(jit.get_jit_instructions() == jit.get_tick_count());
+        REQUIRE(interpreter.get_jit_instructions() == 0);
+    }
+
+    TEST_CASE("no backend runs instructions for a count below one")
+    {
+        static constexpr auto program = to_bit8_program<2>({
+            0x7001, // add vx nn
+            0x1200  // goto 0x200
+        });
+        const auto backend = GENERATE(chip8::Backend::Interpreter, chip8::Backend::Threaded, chip8::Backend::Jit,
+                                      chip8::Backend::Aot);
+        const auto count = GENERATE(0, -1, std::numeric_limits<int>::min());
+
+        chip8::Chip8 chip8;
+        chip8.set_backend(backend);
+        chip8.load_rom(program);
+        chip8.toggle_pause();
+        chip8.run_instructions(count);
+        REQUIRE(chip8.get_tick_count() == 0);
+        REQUIRE(chip8.get_pc() == 0x200);
+        REQUIRE(chip8.get_registers()[0] == 0);
+    }
+
+    TEST_CASE("seeded random numbers are reproducible")
+    {
+        static constexpr auto program = to_bit8_program<3>({
+            0xC0FF, // rand vx nn
+            0xF055, // regdump
+            0x1200  // goto 0x200
+        });
+        const auto run = [](chip8::Chip8 &chip8) {
+            std::vector<uint8_t> numbers;
+            for (auto i = 0; i < 32; i++) {
+                chip8.exec_op_cycle();
+                chip8.exec_op_cycle();
+                chip8.exec_op_cycle();
+                numbers.push_back(chip8.get_registers()[0]);
+            }
+            return numbers;
+        };
+
+        chip8::Chip8 first;
+        chip8::Chip8 second;
+        first.set_seed(42);
+        second.set_seed(42);
+        first.load_rom(program);
+        second.load_rom(program);
+        const auto numbers = run(first);
+        REQUIRE(run(second) == numbers);
+        REQUIRE(std::ranges::adjacent_find(numbers, std::not_equal_to{}) != numbers.end());
+
+        SECTION("reset restarts the sequence") {
+            first.reset_rom();
+            REQUIRE(run(first) == numbers);
+        }
+        SECTION("restoring the generator state repeats the following numbers") {
+            const auto state = first.get_random_state();
+            const auto next = run(first);
+            second.set_random_state(state);
+            REQUIRE(run(second) == next);
+        }
+    }
+
+    TEST_CASE("superinstructions keep the architectural state")
+    {
+        // counted loop drawing sprites, polling the delay timer
+        static constexpr auto program = to_bit8_program<14>({
+            0x6A00, // ld vx nn
+            0x6B05, // ld vx nn
+            0xA240, // ld I nnn
+            0xDAB3, // draw
+            0x7A08, // add vx nn
+            0x3A40, // skip if vx == nn
+            0x1202, // goto 0x202
+            0x6303, // ld vx nn
+            0xF315, // ld DT vx
+            0xF307, // ld vx DT
+            0x3300, // skip if vx == 0
+            0x1212, // goto 0x212
+            0x4A40, // skip if vx != nn
+            0x1200  // goto 0x200
+        });
+        const auto cycles_per_frame = GENERATE(1, 2, 7, 8, 31);
+
+        chip8::Chip8 plain;
+        chip8::Chip8 fused;
+        plain.set_superinstructions(false);
+        for (auto *chip8: {&plain, &fused}) {
+            chip8->set_seed(0xC8);
+            chip8->load_rom(program);
+            chip8->toggle_pause();
+            chip8->cycles_per_frame = cycles_per_frame;
+        }
+        for (int frame = 0; frame < 100; frame++) {
+            plain.tick();
+            fused.tick();
+            require_same_state(fused, plain);
+            REQUIRE(fused.get_call_stack() == plain.get_call_stack());
+        }
+    }
+
+    TEST_CASE("skipping idle loops keeps the architectural state")
+    {
+        // waits for the delay timer, then for a key, then jumps to itself
+        static constexpr auto program = to_bit8_program<8>({
+            0x6305, // ld vx nn
+            0xF315, // ld DT vx
+            0xF407, // ld vx DT
+            0x3400, // skip if vx == nn
+            0x1204, // goto 0x204
+            0xF50A, // ld vx key
+            0x7501, // add vx nn
+            0x120E  // goto 0x20E
+        });
+        const auto backend = GENERATE(chip8::Backend::Interpreter, chip8::Backend::Threaded, chip8::Backend::Jit);
+        const auto cycles_per_frame = GENERATE(1, 7, 100);
+
+        chip8::Chip8 spinning;
+        chip8::Chip8 skipping;
+        spinning.set_idle_skipping(false);
+        for (auto *chip8: {&spinning, &skipping}) {
+            chip8->set_seed(0xC8);
+            chip8->set_backend(backend);
+            chip8->load_rom(program);
+            chip8->toggle_pause();
+            chip8->cycles_per_frame = cycles_per_frame;
+        }
+        for (int frame = 0; frame < 20; frame++) {
+            if (frame == 12) { spinning.keys[9] = skipping.keys[9] = true; }
+            spinning.tick();
+            skipping.tick();
+            require_same_state(skipping, spinning);
+            if (backend == chip8::Backend::Interpreter) { REQUIRE(skipping.get_call_stack() == spinning.get_call_stack()); }
+            // a frame without instructions does not run the FX07 of the loop either
+            spinning.tick(0);
+            skipping.tick(0);
+            require_same_state(skipping, spinning);
+        }
+        REQUIRE(skipping.get_registers()[5] == 10);
+        REQUIRE(skipping.is_idle());
+    }
+
+    TEST_CASE("lockstep lanes match independent instances")
+    {
+        // random numbers and keys make the lanes diverge, the call joins them again
+        static constexpr auto program = to_bit8_program<21>({
+            0x6A00, // ld vx nn
+            0xC00F, // rand vx nn
+            0xC107, // rand vx nn
+            0x8014, // add vx vy
+            0x801E, // shift left
+            0x8F06, // shift right into VF
+            0xF015, // ld DT vx
+            0xF107, // ld vx DT
+            0xA300, // ld I nnn
+            0xF11E, // add I vx
+            0xF255, // regdump
+            0xDA05, // draw
+            0x7A07, // add vx nn
+            0xE19E, // skip if key vx pressed
+            0x3A38, // skip if vx == nn
+            0x1202, // goto 0x202
+            0x6A00, // ld vx nn
+            0x2228, // call 0x228
+            0x1202, // goto 0x202
+            0x0000, // padding
+            0x00EE  // return
+        });
+        const auto use_simd = GENERATE(true, false);
+        const std::vector<uint64_t> seeds{0, 1, 2, 2, 3, 5, 8, 13, 21, 34, 55, 89, 144, 233, 377, 610, 987, 1597, 2584, 4181,
+                                          6765, 10946, 17711, 28657, 46368, 75025, 121393, 196418, 317811, 514229, 832040,
+                                          1346269, 2178309, 3524578, 5702887, 9227465, 14930352};
+        chip8::Lockstep lockstep(program, seeds, {.cycles_per_frame = 9, .use_simd = use_simd});
+        std::vector<std::unique_ptr<chip8::Chip8>> instances;
+        for (const auto seed: seeds) {
+            auto &chip8 = *instances.emplace_back(std::make_unique<chip8::Chip8>());
+            chip8.set_seed(seed);
+            chip8.set_idle_skipping(false);
+            chip8.load_rom(program);
+            chip8.toggle_pause();
+            chip8.cycles_per_frame = 9;
+        }
+
+        for (int frame = 0; frame < 40; frame++) {
+            for (std::size_t lane = 0; lane < seeds.size(); lane++) {
+                const auto keys = static_cast<uint16_t>((static_cast<std::size_t>(frame) + lane) % 5 == 0 ? 0x00FF : 0);
+                lockstep.set_keys(lane, keys);
+                for (std::size_t key = 0; key < instances[lane]->keys.size(); key++) {
+                    instances[lane]->keys[key] = ((keys >> key) & 1U) != 0;
+                }
+            }
+            lockstep.tick();
+            for (std::size_t lane = 0; lane < seeds.size(); lane++) {
+                auto &chip8 = *instances[lane];
+                chip8.tick();
+                REQUIRE(lockstep.get_registers(lane) == chip8.get_registers());
+                REQUIRE(lockstep.get_pc(lane) == chip8.get_pc());
+                REQUIRE(lockstep.get_i(lane) == chip8.get_i());
+                REQUIRE(lockstep.get_delay_timer(lane) == chip8.get_delay_timer());
+                REQUIRE(lockstep.get_sound_timer(lane) == chip8.get_sound_timer());
+                REQUIRE(lockstep.get_stack_pointer(lane) == chip8.get_stack_pointer());
+                REQUIRE(lockstep.get_tick_count(lane) == chip8.get_tick_count());
+                REQUIRE(std::ranges::equal(lockstep.get_memory(lane), chip8.get_memory()));
+                REQUIRE(std::ranges::equal(lockstep.get_display_rows(lane), chip8.get_display_rows()));
+            }
+        }
+        const auto &stats = lockstep.get_stats();
+        REQUIRE(stats.simd_instructions + stats.scalar_instructions == seeds.size() * 40 * 9);
+        if (!use_simd) { REQUIRE(stats.simd_instructions == 0); }
+    }
+
+    TEST_CASE("rewind steps back through the captured frames")
+    {
+        // random sprites at random positions, a register dump changes memory
+        static constexpr auto program = to_bit8_program<8>({
+            0xC03F, // rand vx nn
+            0xC11F, // rand vx nn
+            0xC20F, // rand vx nn
+            0xF229, // ld F, vx
+            0xD015, // draw
+            0xA300, // ld I nnn
+            0xF255, // regdump
+            0x1200  // goto 0x200
+        });
+        // a small arena drops old frames long before the frame index is full
+        const auto arena_bytes = GENERATE(6 * sizeof(chip8::Chip8::SaveState), std::size_t{1} << 20U);
+        chip8::Rewind rewind({.keyframe_interval = 7, .arena_bytes = arena_bytes, .max_frames = 100});
+
+        chip8::Chip8 chip8;
+        chip8.set_seed(0xC8);
+        chip8.load_rom(program);
+        chip8.toggle_pause();
+        std::vector<uint64_t> hashes;
+        std::vector<std::size_t> tick_counts;
+        const auto run = [&](int frames) {
+            for (int frame = 0; frame < frames; frame++) {
+                chip8.tick();
+                rewind.capture(chip8);
+                hashes.push_back(chip8.state_hash());
+                tick_counts.push_back(chip8.get_tick_count());
+            }
+        };
+        run(150);
+
+        const auto stats = rewind.get_stats();
+        REQUIRE(stats.frames == rewind.frames());
+        REQUIRE(stats.frames <= 100);
+        REQUIRE(stats.keyframes == (stats.frames + 6) / 7);
+        REQUIRE(stats.bytes <= stats.arena_bytes);
+        if (arena_bytes > stats.frames * sizeof(chip8::Chip8::SaveState)) {
+            REQUIRE(stats.frames > 100 - 7);
+            REQUIRE(stats.bytes < stats.frames * sizeof(chip8::Chip8::SaveState) / 4);
+        }
+
+        for (std::size_t back = 1; back < stats.frames; back++) {
+            REQUIRE(rewind.step_back(chip8));
+            REQUIRE(chip8.state_hash() == hashes[hashes.size() - 1 - back]);
+            REQUIRE(chip8.get_tick_count() == tick_counts[hashes.size() - 1 - back]);
+        }
+        REQUIRE_FALSE(rewind.step_back(chip8));
+        REQUIRE(rewind.frames() == 1);
+
+        // the program continues from the oldest frame like it did the first time
+        const auto oldest = hashes.size() - stats.frames;
+        const std::vector<uint64_t> expected(hashes.begin() + static_cast<std::ptrdiff_t>(oldest) + 1,
+                                             hashes.begin() + static_cast<std::ptrdiff_t>(oldest) + 21);
+        hashes.clear();
+        run(20);
+        REQUIRE(hashes == expected);
+        REQUIRE(rewind.frames() == 21);
+    }
+
+    TEST_CASE("movies replay to the recorded state")
+    {
+        // waits for a key, draws random sprites while it is held
+        static constexpr auto program = to_bit8_program<8>({
+            0xF00A, // ld vx key
+            0xF029, // ld F, vx
+            0xC13F, // rand vx nn
+            0xD125, // draw
+            0x7203, // add vx nn
+            0xE09E, // skip if key vx pressed
+            0x1200, // goto 0x200
+            0x1204  // goto 0x204
+        });
+        chip8::Chip8 recorded;
+        recorded.set_seed(9);
+        recorded.set_shift_implementation(false);
+        recorded.load_rom(program);
+        recorded.toggle_pause();
+        chip8::MovieRecorder recorder(recorded);
+        for (int frame = 0; frame < 200; frame++) {
+            const auto keys = static_cast<uint16_t>((frame / 4) % 2 == 0 ? 1U << ((frame / 7) % 16) : 0U);
+            const auto instructions = 5 + frame % 3;
+            recorder.record_frame(recorded, keys, instructions);
+            recorded.set_key_mask(keys);
+            recorded.tick(instructions);
+        }
+        const auto movie = recorder.finish(recorded);
+        REQUIRE(movie.frame_count() == 200);
+        REQUIRE(movie.key_changes.size() > 20);
+        REQUIRE(movie.end_state_hash == recorded.state_hash());
+
+        std::stringstream file;
+        REQUIRE(movie.write(file));
+        const auto loaded = chip8::Movie::read(file);
+        REQUIRE(loaded.has_value());
+        REQUIRE(*loaded == movie);
+
+        // the replay splits frames at key changes, independent of backend and idle skipping
+        const auto backend = GENERATE(chip8::Backend::Interpreter, chip8::Backend::Threaded, chip8::Backend::Jit);
+        chip8::Chip8 replayed;
+        replayed.set_backend(backend);
+        replayed.set_idle_skipping(false);
+        replayed.load_rom(program);
+        chip8::MoviePlayer player(*loaded);
+        REQUIRE(player.start(replayed));
+        while (!player.finished()) { REQUIRE(player.play_frame(replayed)); }
+        REQUIRE(player.matches(replayed));
+        REQUIRE(replayed.get_registers() == recorded.get_registers());
+
+        chip8::Chip8 other_rom;
+        other_rom.load_rom(to_bit8_program<1>({0x1200}));
+        REQUIRE_FALSE(chip8::MoviePlayer(movie).start(other_rom));
+    }
+
+    TEST_CASE("seeking a movie reaches the state of a straight replay")
+    {
+        static constexpr auto program = to_bit8_program<7>({
+            0xC13F, // rand vx nn
+            0xF029, // ld F, vx
+            0xD125, // draw
+            0xE09E, // skip if key vx pressed
+            0x1200, // goto 0x200
+            0x7201, // add vx nn
+            0x1200  // goto 0x200
+        });
+        chip8::Chip8 recorded;
+        recorded.set_seed(3);
+        recorded.load_rom(program);
+        recorded.toggle_pause();
+        chip8::MovieRecorder recorder(recorded);
+        for (int frame = 0; frame < 300; frame++) {
+            const auto keys = static_cast<uint16_t>(frame % 10 < 3 ? 1U : 0U);
+            recorder.record_frame(recorded, keys, 7);
+            recorded.set_key_mask(keys);
+            recorded.tick(7);
+        }
+        const auto movie = recorder.finish(recorded);
+
+        // ticks in the middle of frames and right after key changes, in increasing order
+        static constexpr std::array<std::size_t, 6> targets{1, 300, 703, 1000, 1404, 2099};
+        chip8::Chip8 straight;
+        straight.load_rom(program);
+        chip8::MoviePlayer straight_player(movie);
+        REQUIRE(straight_player.start(straight));
+        std::array<uint64_t, targets.size()> hashes{};
+        for (std::size_t idx = 0; idx < targets.size(); idx++) {
+            REQUIRE(straight_player.play_until(straight, targets[idx]));
+            hashes[idx] = straight.state_hash();
+        }
+
+        chip8::Chip8 seeked;
+        seeked.load_rom(program);
+        chip8::MoviePlayer player(movie, 200);
+        REQUIRE(player.start(seeked));
+        while (!player.finished()) { REQUIRE(player.play_frame(seeked)); }
+        REQUIRE(player.matches(seeked));
+        REQUIRE(player.checkpoints() == 11);
+        for (const std::size_t idx: {3U, 0U, 5U, 1U, 2U, 4U, 4U}) {
+            REQUIRE(player.seek(seeked, targets[idx]));
+            REQUIRE(seeked.get_tick_count() == targets[idx]);
+            REQUIRE(seeked.state_hash() == hashes[idx]);
+        }
+        // playing on after a seek into a frame finishes the movie in the recorded state
+        while (!player.finished()) { REQUIRE(player.play_frame(seeked)); }
+        REQUIRE(player.matches(seeked));
+        REQUIRE_FALSE(player.seek(seeked, movie.end_tick + 1));
+    }
+
+    TEST_CASE("run-ahead shows later frames and restores the state")
+    {
+        static constexpr auto program = to_bit8_program<5>({
+            0xE09E, // skip if key vx pressed
+            0x1200, // goto 0x200
+            0xF029, // ld F, vx
+            0xD125, // draw
+            0x1208  // goto 0x208
+        });
+        chip8::Chip8 chip8;
+        chip8.load_rom(program);
+        chip8.toggle_pause();
+        const auto consumer = chip8.add_display_consumer();
+        chip8.set_key_mask(1);
+        chip8.tick(1);
+        // a new consumer starts with the whole display to draw
+        REQUIRE(chip8.take_dirty_rows(consumer) == chip8::Chip8::all_rows_dirty);
+        const auto hash = chip8.state_hash();
+        const auto rows = chip8.get_display_rows();
+        const auto history = chip8.get_call_stack();
+        REQUIRE_FALSE(history.empty());
+
+        chip8::RunAhead run_ahead(2);
+        chip8::Chip8::DisplayRows ahead{};
+        chip8::Chip8::DirtyRows dirty = 0;
+        REQUIRE(run_ahead.run(chip8, 8, consumer, ahead, dirty));
+        REQUIRE(chip8.state_hash() == hash);
+        REQUIRE(chip8.get_call_stack() == history);
+        REQUIRE(chip8.get_fault_logging());
+        REQUIRE(chip8.get_display_rows() == rows);
+        REQUIRE(ahead != rows);
+        REQUIRE(dirty != 0);
+        // the rows drawn ahead are redrawn with the next frame
+        REQUIRE(chip8.take_dirty_rows(consumer) == dirty);
+        REQUIRE(run_ahead.get_nanoseconds() > 0);
+
+        chip8.tick(8);
+        chip8.tick(8);
+        REQUIRE(chip8.get_display_rows() == ahead);
+        chip8.toggle_pause();
+        REQUIRE_FALSE(run_ahead.run(chip8, 8, consumer, ahead, dirty));
+    }
+
+    TEST_CASE("triple buffer and queue hand over values between threads")
+    {
+        SECTION("the reader gets the latest published value") {
+            TripleBuffer<int> buffer(0);
+            REQUIRE_FALSE(buffer.update());
+            REQUIRE(buffer.read_buffer() == 0);
+            buffer.write_buffer() = 1;
+            buffer.publish();
+            buffer.write_buffer() = 2;
+            buffer.publish();
+            REQUIRE(buffer.update());
+            REQUIRE(buffer.read_buffer() == 2);
+            REQUIRE_FALSE(buffer.update());
+            REQUIRE(buffer.read_buffer() == 2);
+        }
+        SECTION("values arrive in order, a full queue rejects pushes") {
+            SpscQueue<int, 4> queue;
+            for (int value = 0; value < 4; value++) { REQUIRE(queue.push(value)); }
+            REQUIRE_FALSE(queue.push(4));
+            for (int value = 0; value < 4; value++) { REQUIRE(queue.pop() == value); }
+            REQUIRE_FALSE(queue.pop().has_value());
+        }
+    }
+
+    TEST_CASE("work stealing pool runs every task once")
+    {
+        const auto threads = GENERATE(1U, 2U, 7U);
+        WorkStealingPool pool(threads);
+        std::vector<std::atomic<int>> calls(10000);
+        // uneven tasks, the workers with the short ones have to steal
+        pool.run(calls.size(), [&calls](std::size_t index) {
+            if (index < 100) { std::this_thread::sleep_for(std::chrono::microseconds(100)); }
+            calls[index]++;
+        });
+        REQUIRE(std::ranges::all_of(calls, [](const auto &count) { return count == 1; }));
+
+        REQUIRE_THROWS_AS(pool.run(100, [](std::size_t index) {
+            if (index == 42) { throw std::runtime_error("task failed"); }
+        }), std::runtime_error);
+    }
+
+    TEST_CASE("emulation clock follows the host time")
+    {
+        // a tight loop of 3 instructions
+        static constexpr auto program = to_bit8_program<3>({
+            0x60FF, // ld vx nn
+            0xF015, // ld DT vx
+            0x1202  // goto 0x202
+        });
+        using namespace std::chrono_literals;
+        std::chrono::nanoseconds now{0};
+        chip8::EmulationClock clock([&now] { return now; }, 600);
+        chip8::Chip8 chip8;
+        chip8.load_rom(program);
+        chip8.toggle_pause();
+
+        SECTION("timers run at 60 Hz independent of how often the clock is advanced") {
+            int frames = 0;
+            // 144 Hz host
+            for (int refresh = 1; refresh <= 144; refresh++) {
+                now = std::chrono::nanoseconds(1s) * refresh / 144;
+                frames += clock.advance(chip8);
+            }
+            REQUIRE(frames == 60);
+            REQUIRE(chip8.get_tick_count() == 600);
+        }
+        SECTION("fractional instructions are carried over to the next frames") {
+            clock.set_instructions_per_second(100);
+            for (int refresh = 1; refresh <= 120; refresh++) {
+                now = std::chrono::nanoseconds(1s) * refresh / 60;
+                clock.advance(chip8);
+            }
+            REQUIRE(chip8.get_tick_count() == 200);
+        }
+        SECTION("after a stall at most max_catch_up_frames are run") {
+            now = 10s;
+            REQUIRE(clock.advance(chip8) == chip8::EmulationClock::max_catch_up_frames);
+            REQUIRE(clock.advance(chip8) == 0);
+            REQUIRE(clock.until_next_frame() == std::chrono::nanoseconds(1s) / 60);
+            now += 20ms;
+            REQUIRE(clock.advance(chip8) == 1);
+            REQUIRE(chip8.get_tick_count() == 6 * 10);
+        }
+    }
+
+    TEST_CASE("emulation thread executes commands and publishes snapshots")
+    {
+        static constexpr auto program = to_bit8_program<5>({
+            0x6105, // ld vx nn
+            0xE19E, // skip if key vx pressed
+            0x1202, // goto 0x202
+            0x6201, // ld vx nn
+            0x1208  // goto 0x208
+        });
+        chip8::Chip8 chip8;
+        chip8.load_rom(program);
+        chip8::EmulationThread emulation(chip8);
+
+        // wait for the emulation thread, it runs at its own pace
+        const auto wait_for = [&emulation](auto condition) {
+            const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (std::chrono::steady_clock::now() < timeout) {
+                emulation.update_snapshot();
+                if (condition(emulation.snapshot())) { return true; }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return false;
+        };
+
+        REQUIRE(emulation.snapshot().state == chip8::State::Reset);
+        REQUIRE(emulation.send(chip8::command::TogglePause{}));
+        REQUIRE(wait_for([](const auto &snapshot) { return snapshot.state == chip8::State::Running; }));
+        REQUIRE(emulation.snapshot().registers[2] == 0);
+
+        emulation.set_key(5, true);
+        REQUIRE(wait_for([](const auto &snapshot) { return snapshot.pc == 0x208; }));
+        REQUIRE(emulation.snapshot().registers[2] == 1);
+
+        REQUIRE(emulation.send(chip8::command::ResetRom{}));
+        REQUIRE(wait_for([](const auto &snapshot) { return snapshot.state == chip8::State::Reset; }));
+        REQUIRE(emulation.snapshot().registers[2] == 0);
+    }
 
 } // namespace chip8_tests